@@ -5,6 +5,7 @@
 #endif
 
 #include "/include/common.h"
+#include "/include/uniforms.h"
 
 // TODO: Use this when when using hardware depth buffer.
 // layout(early_fragment_tests) in;
@@ -14,26 +15,11 @@ layout(location = 1) out vec4 g_base_color_roughness;
 layout(location = 2) out vec4 g_velocity;
 layout(location = 3) out uint id;
 
-uniform vec3 u_light_pos;
-uniform mat3 u_normal_mat;
-
-uniform bool u_use_sampler;
-uniform bool u_use_normal;
-uniform bool u_use_metallic_roughness;
+layout(std430, binding = 0) readonly buffer Draws { DrawData draws[]; };
 
 uniform sampler2D u_base_color;
 uniform sampler2D u_metallic_roughness;
 uniform sampler2D u_normal;
-uniform sampler2D u_shadow_map;
-
-uniform float u_metallic_factor;
-uniform float u_roughness_factor;
-uniform vec3 u_base_color_factor;
-
-uniform float u_far_clip_distance;
-
-uniform bool u_alpha_mask;
-uniform float u_alpha_cutoff;
 
 uniform vec2 u_jitter;
 uniform vec2 u_jitter_prev;
@@ -44,9 +30,9 @@ in Varying
     vec3 normal;
     vec2 tex_coords;
     vec4 tangent;
-    vec4 light_space_pos;
     vec4 position;
     vec4 position_prev;
+    flat uint draw_id;
 }
 fs_in;
 
@@ -63,12 +49,15 @@ mat3 calculate_tbn_matrix(vec4 tangent_sign, vec3 normal)
 
 void main()
 {
-    g_base_color_roughness.rgb = u_base_color_factor;
+    DrawData draw = draws[fs_in.draw_id];
+
+    g_base_color_roughness.rgb = draw.base_color_factor.rgb;
 
-    if (u_use_sampler)
+    if ((draw.flags & DRAW_USE_BASE_COLOR) != 0)
     {
         vec4 base_color_alpha = texture(u_base_color, fs_in.tex_coords);
-        if (u_alpha_mask && base_color_alpha.a < u_alpha_cutoff)
+        if ((draw.flags & DRAW_ALPHA_MASK) != 0 &&
+            base_color_alpha.a < draw.alpha_cutoff)
         {
             discard; // FIXME: Bad.
         }
@@ -76,7 +65,7 @@ void main()
         g_base_color_roughness.rgb *= base_color_alpha.rgb;
     }
 
-    if (u_use_normal)
+    if ((draw.flags & DRAW_USE_NORMAL) != 0)
     {
         mat3 tbn = calculate_tbn_matrix(fs_in.tangent, fs_in.normal);
         vec3 normal_tangent =
@@ -93,10 +82,10 @@ void main()
         g_normal_metallic.xyz = normalize(fs_in.normal);
     }
 
-    g_normal_metallic.a = u_metallic_factor;
-    g_base_color_roughness.a = u_roughness_factor;
+    g_normal_metallic.a = draw.metallic_factor;
+    g_base_color_roughness.a = draw.roughness_factor;
 
-    if (u_use_metallic_roughness)
+    if ((draw.flags & DRAW_USE_METALLIC_ROUGHNESS) != 0)
     {
         vec2 metallic_roughness =
             texture(u_metallic_roughness, fs_in.tex_coords).bg;
@@ -1,39 +1,43 @@
 #version 460 core
 
+#ifdef VALIDATOR
+#extension GL_GOOGLE_include_directive : require
+#endif
+
+#include "/include/uniforms.h"
+
 layout(location = 0) in vec3 a_position;
 layout(location = 1) in vec3 a_normal;
 layout(location = 2) in vec2 a_tex_coords;
 layout(location = 3) in vec4 a_tangent;
 
-uniform mat4 u_model;
-uniform mat4 u_mvp;
-uniform mat4 u_mvp_prev;
-uniform mat3 u_normal_mat;
-
-uniform mat4 u_light_transform;
+layout(std430, binding = 0) readonly buffer Draws { DrawData draws[]; };
 
 out Varying
 {
     vec3 normal;
     vec2 tex_coords;
     vec4 tangent;
-    vec4 light_space_pos;
     vec4 position;
     vec4 position_prev;
+    flat uint draw_id;
 }
 vs_out;
 
 void main()
 {
-    vs_out.normal = u_normal_mat * a_normal;
+    // Set through the base instance of each draw.
+    DrawData draw = draws[gl_BaseInstance];
+    mat3 normal_mat = mat3(draw.normal_mat);
+
+    vs_out.normal = normal_mat * a_normal;
     vs_out.tex_coords = a_tex_coords;
-    vs_out.tangent.xyz = u_normal_mat * a_tangent.xyz;
+    vs_out.tangent.xyz = normal_mat * a_tangent.xyz;
     vs_out.tangent.w = a_tangent.w;
 
-    vs_out.light_space_pos = u_light_transform * u_model * vec4(a_position, 1);
-
-    vs_out.position = u_mvp * vec4(a_position, 1.);
-    vs_out.position_prev = u_mvp_prev * vec4(a_position, 1.);
+    vs_out.position = draw.mvp * vec4(a_position, 1.);
+    vs_out.position_prev = draw.mvp_prev * vec4(a_position, 1.);
+    vs_out.draw_id = gl_BaseInstance;
 
     gl_Position = vs_out.position;
-}
\ No newline at end of file
+}
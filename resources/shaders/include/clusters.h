@@ -0,0 +1,16 @@
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+// Index of the froxel containing a point, given its texture coordinates on
+// screen and its positive view space depth. Slices are spaced exponentially
+// in depth, see "Clustered Deferred and Forward Shading" by Olsson et al.
+uint cluster_index(uvec3 dims, float scale, float bias, vec2 tex_coords,
+                   float depth)
+{
+    uvec2 xy = min(uvec2(tex_coords * vec2(dims.xy)), dims.xy - 1);
+    uint z = uint(clamp(log(depth) * scale - bias, 0., float(dims.z - 1)));
+
+    return xy.x + dims.x * (xy.y + dims.y * z);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SHADOW_H
 #define SHADOW_H
 
+#ifdef CASCADE_COUNT
 uint calculate_cascade_index(vec3 pos, float cascade_distances[CASCADE_COUNT])
 {
     uint cascade_idx = CASCADE_COUNT - 1;
@@ -17,5 +18,56 @@ uint calculate_cascade_index(vec3 pos, float cascade_distances[CASCADE_COUNT])
 
     return 0;
 }
+#endif
+
+// Selects the cube face of a direction and the coordinates on it, following
+// the face selection rules of cube map sampling. Faces are ordered +X, -X,
+// +Y, -Y, +Z, -Z.
+uint cube_face(vec3 dir, out vec2 uv)
+{
+    vec3 a = abs(dir);
+    uint face;
+    float major;
+    vec2 st;
+
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = dir.x > 0. ? 0 : 1;
+        major = a.x;
+        st = vec2(dir.x > 0. ? -dir.z : dir.z, -dir.y);
+    }
+    else if (a.y >= a.z)
+    {
+        face = dir.y > 0. ? 2 : 3;
+        major = a.y;
+        st = vec2(dir.x, dir.y > 0. ? dir.z : -dir.z);
+    }
+    else
+    {
+        face = dir.z > 0. ? 4 : 5;
+        major = a.z;
+        st = vec2(dir.z > 0. ? dir.x : -dir.x, -dir.y);
+    }
+
+    uv = 0.5 * (st / major + 1.);
+    return face;
+}
+
+// Point light shadow of a fragment, rect is the atlas tile of the face in
+// texture coordinates. Returns one when the fragment is occluded.
+float sample_point_shadow(sampler2DShadow atlas, vec4 rect, vec2 uv,
+                          float depth)
+{
+    // The face has no tile in the atlas.
+    if (rect.z == 0.)
+        return 0.;
+
+    // Keep bilinear taps inside the tile.
+    vec2 half_texel = 0.5 / vec2(textureSize(atlas, 0));
+    uv = clamp(rect.xy + uv * rect.zw, rect.xy + half_texel,
+               rect.xy + rect.zw - half_texel);
+
+    return 1. - texture(atlas, vec3(uv, depth));
+}
 
 #endif
\ No newline at end of file
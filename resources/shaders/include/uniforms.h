@@ -14,6 +14,7 @@ struct VolumetricUniforms
     bool bilateral_upsample;
     vec3 sun_color;
     float scatter_amount;
+    bool clustered_lights;
 };
 
 struct ToneMapUniforms
@@ -44,6 +45,7 @@ struct LightingUniforms
     bool reflections;
     bool ambient_occlusion;
     vec3 grid_dims;
+    bool clustered_lights;
     vec3 light_intensity;
     vec3 light_direction;
 };
@@ -55,6 +57,44 @@ struct TaaUniforms
     ivec2 size;
     int reconstruct_filter;
     int flags;
+    ivec2 source_size;
+};
+
+const uint DRAW_ALPHA_MASK = 1u << 0;
+const uint DRAW_USE_BASE_COLOR = 1u << 1;
+const uint DRAW_USE_NORMAL = 1u << 2;
+const uint DRAW_USE_METALLIC_ROUGHNESS = 1u << 3;
+
+struct DrawData
+{
+    mat4 mvp;
+    mat4 mvp_prev;
+    mat4 normal_mat;
+    vec4 base_color_factor;
+    float metallic_factor;
+    float roughness_factor;
+    float alpha_cutoff;
+    uint flags;
+};
+
+struct PointLightData
+{
+    vec3 position;
+    float radius;
+    vec3 color;
+    float radius_squared;
+};
+
+struct ClusterUniforms
+{
+    mat4 view;
+    mat4 proj_inv;
+    uvec3 dims;
+    uint light_count;
+    float scale;
+    float bias;
+    float near;
+    float far;
 };
 
 #endif
\ No newline at end of file
@@ -5,6 +5,7 @@
 #define CASCADE_COUNT 1
 #endif
 
+#include "/include/clusters.h"
 #include "/include/common.h"
 #include "/include/pbs.h"
 #include "/include/shadow.h"
@@ -32,6 +33,18 @@ layout(binding = 11) uniform sampler3D u_sh_6;
 layout(binding = 12) uniform sampler2D u_hdr_prev;
 layout(binding = 13) uniform sampler2D u_reflections;
 layout(binding = 14) uniform sampler2D u_g_velocity;
+layout(binding = 15) uniform sampler2DShadow u_point_shadows;
+
+layout(std140, binding = 1) uniform Clusters { ClusterUniforms c; };
+
+// Atlas tiles of the point light cube faces, six per light.
+layout(std430, binding = 0) readonly buffer ShadowRects { vec4 rects[]; };
+layout(std430, binding = 1) readonly buffer Lights { PointLightData lights[]; };
+layout(std430, binding = 2) readonly buffer ClusterGrid { uvec2 clusters[]; };
+layout(std430, binding = 3) readonly buffer ClusterLights
+{
+    uint light_indices[];
+};
 
 uniform mat4 u_light_transforms[CASCADE_COUNT];
 uniform float u_cascade_distances[CASCADE_COUNT];
@@ -89,6 +102,49 @@ float calculate_shadow(vec4 light_pos, uint cascade_idx, vec3 normal,
     return shadow;
 }
 
+float attenuate(float dist_squared) { return 4. * PI / dist_squared; }
+
+// Contribution of the point lights in the fragment's cluster.
+vec3 calculate_point_lights(vec3 pos, vec3 v, vec3 n, vec3 diffuse_color,
+                            vec3 f0, float roughness)
+{
+    uvec2 cluster =
+        clusters[cluster_index(c.dims, c.scale, c.bias, tex_coords, -pos.z)];
+    vec3 pos_world = (u.view_inv * vec4(pos, 1.)).xyz;
+
+    vec3 luminance = vec3(0.);
+
+    for (uint i = 0; i < cluster.y; i++)
+    {
+        uint light_idx = light_indices[cluster.x + i];
+        PointLightData light = lights[light_idx];
+
+        vec3 light_to_frag = pos_world - light.position;
+        float dist_squared = dot(light_to_frag, light_to_frag);
+
+        if (dist_squared > light.radius_squared)
+            continue;
+
+        vec3 l = normalize(mat3(c.view) * -light_to_frag);
+
+        vec2 uv;
+        uint face = cube_face(light_to_frag, uv);
+        float shadow = sample_point_shadow(
+            u_point_shadows, rects[6 * light_idx + face], uv,
+            sqrt(dist_squared) / light.radius);
+
+        const float falloff_ratio = 0.7;
+        float falloff = smoothstep(light.radius_squared,
+                                   light.radius_squared * falloff_ratio,
+                                   dist_squared);
+
+        luminance += (1. - shadow) * falloff * attenuate(dist_squared) *
+                     brdf(v, l, n, diffuse_color, f0, roughness) * light.color;
+    }
+
+    return luminance;
+}
+
 vec3 calculate_indirect_lighting(vec3 pos, vec3 n)
 {
     vec3 pos_world = (u.view_inv * vec4(pos, 1.f)).xyz;
@@ -166,6 +222,10 @@ void main()
         float shadow = calculate_shadow(light_pos, cascade_idx, n, l);
 
         out_luminance += (1. - shadow) * luminance;
+
+        if (u.clustered_lights)
+            out_luminance += calculate_point_lights(pos, v, n, diffuse_color,
+                                                    f0, roughness);
     }
 
     if (u.indirect_lighting)
@@ -6,21 +6,13 @@
 
 #include "/include/common.h"
 #include "/include/pbs.h"
+#include "/include/shadow.h"
 #include "/include/uniforms.h"
 
-struct PointLight
-{
-    vec3 position;
-    vec3 color;
-    float radius;
-    float radius_squared;
-};
-
 // TODO:
 uniform mat4 u_view;
-uniform int u_light_idx;
 
-uniform PointLight u_light;
+flat in uint v_light_idx;
 
 layout(std140, binding = 0) uniform Uniform { LightingUniforms u; };
 
@@ -28,29 +20,36 @@ layout(binding = 0) uniform sampler2D u_g_depth;
 layout(binding = 1) uniform sampler2D u_g_normal_metallic;
 layout(binding = 2) uniform sampler2D u_g_base_color_roughness;
 
-layout(binding = 15) uniform samplerCubeArrayShadow u_shadow;
+layout(binding = 15) uniform sampler2DShadow u_shadow;
+
+// Atlas tiles of the cube faces, six per light.
+layout(std430, binding = 0) readonly buffer ShadowRects { vec4 rects[]; };
+layout(std430, binding = 1) readonly buffer Lights { PointLightData lights[]; };
 
 out vec4 frag_color;
 
-float calculate_shadow(vec3 frag_pos_world, vec3 light_pos_world)
+float calculate_shadow(vec3 frag_pos_world, PointLightData light)
 {
-    vec3 light_to_frag = frag_pos_world - light_pos_world;
+    vec3 light_to_frag = frag_pos_world - light.position;
     float light_dist = length(light_to_frag);
 
-    float shadow = 1. - texture(u_shadow, vec4(light_to_frag, u_light_idx),
-                                light_dist / u_light.radius);
+    vec2 uv;
+    uint face = cube_face(light_to_frag, uv);
 
-    return shadow;
+    return sample_point_shadow(u_shadow, rects[6 * v_light_idx + face], uv,
+                               light_dist / light.radius);
 }
 
 float attenuate(float dist_squared) { return 4. * PI / dist_squared; }
 
 void main()
 {
+    PointLightData light = lights[v_light_idx];
+
     vec2 tex_coords =
         gl_FragCoord.xy / textureSize(u_g_base_color_roughness, 0);
 
-    vec3 light_pos = (u_view * vec4(u_light.position, 1.)).xyz;
+    vec3 light_pos = (u_view * vec4(light.position, 1.)).xyz;
     vec3 pos = pos_from_depth(
         linearize_depth(texture(u_g_depth, tex_coords).r, u.proj), tex_coords,
         u.proj_inv);
@@ -59,7 +58,7 @@ void main()
     vec3 pos_to_light = light_pos - pos;
     float dist_squared = dot(pos_to_light, pos_to_light);
 
-    if (dist_squared > u_light.radius_squared)
+    if (dist_squared > light.radius_squared)
         discard;
 
     vec3 l = normalize(pos_to_light);
@@ -80,15 +79,15 @@ void main()
     vec3 f0;
     decode_material(base_color, metallic, diffuse_color, f0);
 
-    float shadow = calculate_shadow(pos_world, u_light.position);
+    float shadow = calculate_shadow(pos_world, light);
     vec3 luminance = (1. - shadow) * attenuate(dist_squared) *
                      brdf(v, l, n, diffuse_color, f0, roughness) *
-                     u_light.color;
+                     light.color;
 
     const float falloff_ratio = 0.7;
     luminance *=
-        smoothstep(u_light.radius_squared,
-                   u_light.radius_squared * falloff_ratio, dist_squared);
+        smoothstep(light.radius_squared,
+                   light.radius_squared * falloff_ratio, dist_squared);
 
     frag_color = vec4(luminance, 1.);
 }
\ No newline at end of file
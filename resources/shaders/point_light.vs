@@ -1,21 +1,33 @@
 #version 460 core
 
-layout(location = 0) in vec3 a_position;
+#ifdef VALIDATOR
+#extension GL_GOOGLE_include_directive : require
+#endif
 
-struct PointLight
-{
-    vec3 position;
-    vec3 color;
-    float radius;
-    float radius_squared;
-};
+#include "/include/uniforms.h"
+
+layout(location = 0) in vec3 a_position;
 
-uniform PointLight u_light;
+layout(std430, binding = 1) readonly buffer Lights { PointLightData lights[]; };
 
 layout(location = 1) uniform mat4 u_view_proj;
 
+// One instance per light.
+flat out uint v_light_idx;
+
 void main()
 {
-    vec3 pos = u_light.radius * a_position + u_light.position;
+    PointLightData light = lights[gl_InstanceID];
+
+#ifdef MARKER_RADIUS
+    // Small sphere marking the light's position instead of its volume.
+    float radius = MARKER_RADIUS;
+#else
+    float radius = light.radius;
+#endif
+
+    v_light_idx = gl_InstanceID;
+
+    vec3 pos = radius * a_position + light.position;
     gl_Position = u_view_proj * vec4(pos, 1.);
-}
\ No newline at end of file
+}
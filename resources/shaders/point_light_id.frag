@@ -1,10 +1,10 @@
 #version 460 core
 
-uniform uint u_id;
+flat in uint v_light_idx;
 
 layout(location = 3) out uint id;
 
 void main()
 {
-	id = u_id;
-}
\ No newline at end of file
+	id = v_light_idx;
+}
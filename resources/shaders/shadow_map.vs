@@ -2,6 +2,12 @@
 
 layout(location = 0) in vec3 pos;
 
-uniform mat4 u_model;
+layout(std430, binding = 0) readonly buffer Models { mat4 models[]; };
 
-void main() { gl_Position = u_model * vec4(pos, 1); }
\ No newline at end of file
+flat out uint v_caster;
+
+void main()
+{
+    v_caster = gl_BaseInstance;
+    gl_Position = models[gl_BaseInstance] * vec4(pos, 1);
+}
\ No newline at end of file
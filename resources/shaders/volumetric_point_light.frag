@@ -6,37 +6,33 @@
 
 #include "/include/common.h"
 #include "/include/math.h"
+#include "/include/shadow.h"
 #include "/include/uniforms.h"
 
-struct PointLight
-{
-    vec3 position;
-    vec3 color;
-    float radius;
-    float radius_squared;
-};
-
-uniform int u_light_idx;
-
-uniform PointLight u_light;
+flat in uint v_light_idx;
 
 layout(std140, binding = 0) uniform Uniform { VolumetricUniforms u; };
 
 layout(binding = 1) uniform sampler2D u_g_depth;
 
-layout(binding = 5) uniform samplerCubeArrayShadow u_shadow;
+layout(binding = 5) uniform sampler2DShadow u_shadow;
+
+// Atlas tiles of the cube faces, six per light.
+layout(std430, binding = 0) readonly buffer ShadowRects { vec4 rects[]; };
+layout(std430, binding = 1) readonly buffer Lights { PointLightData lights[]; };
 
 out vec4 frag_color;
 
-float calculate_shadow(vec3 frag_pos_world, vec3 light_pos_world)
+float calculate_shadow(vec3 frag_pos_world, PointLightData light)
 {
-    vec3 light_to_frag = frag_pos_world - light_pos_world;
+    vec3 light_to_frag = frag_pos_world - light.position;
     float light_dist = length(light_to_frag);
 
-    float shadow = 1. - texture(u_shadow, vec4(light_to_frag, u_light_idx),
-                                light_dist / u_light.radius);
+    vec2 uv;
+    uint face = cube_face(light_to_frag, uv);
 
-    return shadow;
+    return sample_point_shadow(u_shadow, rects[6 * v_light_idx + face], uv,
+                               light_dist / light.radius);
 }
 
 float attenuate(float dist_squared) { return 4. * PI / dist_squared; }
@@ -62,9 +58,11 @@ bool ray_sphere_intersect(vec3 o, vec3 d, vec3 c, float r2, out vec2 hit)
 
 void main()
 {
+    PointLightData light = lights[v_light_idx];
+
     vec2 tex_coords = gl_FragCoord.xy / (u.read_size / 2);
 
-    vec3 light_pos = (u.view * vec4(u_light.position, 1.)).xyz;
+    vec3 light_pos = (u.view * vec4(light.position, 1.)).xyz;
     float depth =
         linearize_depth(textureLod(u_g_depth, tex_coords, 1).r, u.proj);
     vec3 pos = pos_from_depth(depth, tex_coords, u.proj_inv);
@@ -75,7 +73,7 @@ void main()
     vec2 hit;
     vec3 color;
 
-    if (ray_sphere_intersect(vec3(0), v, light_pos, u_light.radius_squared,
+    if (ray_sphere_intersect(vec3(0), v, light_pos, light.radius_squared,
                              hit))
     {
         // vec3 ray_origin = vec3(0.);
@@ -100,7 +98,7 @@ void main()
         for (int i = 0; i < u.step_count; i++)
         {
             vec3 ray_pos_world = (u.view_inv * vec4(ray_pos, 1.)).xyz;
-            float shadow = calculate_shadow(ray_pos_world, u_light.position);
+            float shadow = calculate_shadow(ray_pos_world, light);
 
             vec3 pos_to_light = light_pos - ray_pos;
             float dist_squared = dot(pos_to_light, pos_to_light);
@@ -112,7 +110,7 @@ void main()
                 henyey_greenstein(dot(ray_dir, l), u.scatter_intensity);
 
             fog +=
-                attenuate(dist_squared) * u_light.color * factor * (1 - shadow);
+                attenuate(dist_squared) * light.color * factor * (1 - shadow);
 
             ray_pos += ray_step;
         }
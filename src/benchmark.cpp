@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <fmt/format.h>
+
+#include "benchmark.hpp"
+#include "logger.hpp"
+
+using namespace engine;
+using namespace glm;
+using namespace std;
+
+using std::filesystem::path;
+
+using Clock = chrono::steady_clock;
+
+optional<CameraPath> CameraPath::load(const path &path)
+{
+    ifstream file(path);
+    if (!file)
+    {
+        logger.error("Failed opening camera path {}", path.string());
+        return nullopt;
+    }
+
+    CameraPath result;
+
+    string line;
+    for (int line_idx = 1; getline(file, line); line_idx++)
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        istringstream stream(line);
+        CameraKey key;
+
+        if (!(stream >> key.time >> key.position.x >> key.position.y >>
+              key.position.z >> key.target.x >> key.target.y >> key.target.z))
+        {
+            logger.error("{}:{}: expected time, position and target",
+                         path.string(), line_idx);
+            return nullopt;
+        }
+
+        result.keys.push_back(key);
+    }
+
+    if (result.keys.empty())
+    {
+        logger.error("Camera path {} has no keys", path.string());
+        return nullopt;
+    }
+
+    ranges::sort(result.keys, {}, &CameraKey::time);
+
+    return result;
+}
+
+float CameraPath::duration() const
+{
+    return keys.back().time - keys.front().time;
+}
+
+static vec3 catmull_rom(vec3 p0, vec3 p1, vec3 p2, vec3 p3, float t)
+{
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+
+    return 0.5f * (2.f * p1 + (p2 - p0) * t +
+                   (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 +
+                   (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+}
+
+CameraKey CameraPath::sample(float time) const
+{
+    time = std::clamp(time + keys.front().time, keys.front().time,
+                      keys.back().time);
+
+    // First key after the time, the segment ends there.
+    const auto upper =
+        ranges::upper_bound(keys, time, {}, &CameraKey::time) - keys.begin();
+    const size_t i1 = std::max<ptrdiff_t>(upper - 1, 0);
+    const size_t i2 = std::min<size_t>(i1 + 1, keys.size() - 1);
+    const size_t i0 = i1 == 0 ? 0 : i1 - 1;
+    const size_t i3 = std::min<size_t>(i2 + 1, keys.size() - 1);
+
+    const float span = keys[i2].time - keys[i1].time;
+    const float t = span > 0.f ? (time - keys[i1].time) / span : 0.f;
+
+    return {
+        .time = time,
+        .position = catmull_rom(keys[i0].position, keys[i1].position,
+                                keys[i2].position, keys[i3].position, t),
+        .target = catmull_rom(keys[i0].target, keys[i1].target,
+                              keys[i2].target, keys[i3].target, t),
+    };
+}
+
+Benchmark::Benchmark(int warmup_frames) : warmup_frames(warmup_frames) {}
+
+void Benchmark::frame()
+{
+    const auto now = Clock::now();
+
+    // The interval ending now is the time of the previous frame.
+    if (last_frame && frame_count > warmup_frames)
+        cpu_frame_ms.push_back(
+            chrono::duration<float, milli>(now - *last_frame).count());
+
+    last_frame = now;
+    frame_count++;
+}
+
+void Benchmark::record(const ProfiledFrame &frame)
+{
+    // Frames without zones didn't render, e.g., the one closing the run.
+    if (frame.index < static_cast<uint64_t>(warmup_frames) ||
+        frame.zones.empty())
+        return;
+
+    float gpu_ms = 0.f;
+
+    // A zone entered several times in a frame counts once, with the sums.
+    map<string, pair<float, float>> frame_zones;
+
+    for (const auto &z : frame.zones)
+    {
+        const float zone_gpu_ms =
+            static_cast<float>(z.gpu_end_ns - z.gpu_begin_ns) / 1e6f;
+        const float zone_cpu_ms =
+            chrono::duration<float, milli>(z.cpu_end - z.cpu_begin).count();
+
+        const string zone_path = profiler_zone_path(z.zone);
+        if (zone_path.find('/') == string::npos)
+            gpu_ms += zone_gpu_ms;
+
+        auto &[gpu, cpu] = frame_zones[zone_path];
+        gpu += zone_gpu_ms;
+        cpu += zone_cpu_ms;
+    }
+
+    gpu_frame_ms.push_back(gpu_ms);
+
+    for (const auto &[zone_path, times] : frame_zones)
+    {
+        zone_gpu_ms[zone_path].push_back(times.first);
+        zone_cpu_ms[zone_path].push_back(times.second);
+    }
+}
+
+void Benchmark::report() const
+{
+    const auto print_stats = [](const string &name, const ZoneStats &s)
+    {
+        fmt::print("{:<40} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f}\n", name,
+                   s.mean, s.p50, s.p95, s.p99);
+    };
+
+    fmt::print("{} frames measured on the CPU, {} on the GPU, {} warmup "
+               "frames skipped\n\n",
+               cpu_frame_ms.size(), gpu_frame_ms.size(), warmup_frames);
+
+    fmt::print("{:<40} {:>9} {:>9} {:>9} {:>9}\n", "Frame time (ms)", "mean",
+               "median", "p95", "p99");
+    print_stats("CPU", compute_zone_stats(cpu_frame_ms));
+    print_stats("GPU", compute_zone_stats(gpu_frame_ms));
+
+    fmt::print("\n{:<40} {:>9} {:>9} {:>9} {:>9}\n", "GPU zone (ms)", "mean",
+               "median", "p95", "p99");
+    for (const auto &[zone_path, samples] : zone_gpu_ms)
+        print_stats(zone_path, compute_zone_stats(samples));
+
+    fmt::print("\n{:<40} {:>9} {:>9} {:>9} {:>9}\n", "CPU zone (ms)", "mean",
+               "median", "p95", "p99");
+    for (const auto &[zone_path, samples] : zone_cpu_ms)
+        print_stats(zone_path, compute_zone_stats(samples));
+
+    if (const auto dropped = profiler_dropped_frames(); dropped > 0)
+        fmt::print("\n{} frames dropped by the profiler\n", dropped);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "profiler.hpp"
+
+namespace engine
+{
+
+struct CameraKey
+{
+    float time;
+    glm::vec3 position;
+    glm::vec3 target;
+};
+
+// Catmull-Rom spline through camera keys. Files hold one key per line, as
+// "time px py pz tx ty tz", lines starting with '#' are comments.
+class CameraPath
+{
+    std::vector<CameraKey> keys;
+
+  public:
+    static std::optional<CameraPath> load(const std::filesystem::path &path);
+
+    float duration() const;
+
+    // Position and target at the given time since the first key, clamped to
+    // the path.
+    CameraKey sample(float time) const;
+};
+
+// Collects frame times and per-zone GPU times of a benchmark run, frames
+// before warmup_frames are ignored.
+class Benchmark
+{
+    int warmup_frames;
+    int frame_count = 0;
+
+    std::optional<std::chrono::steady_clock::time_point> last_frame;
+    std::vector<float> cpu_frame_ms;
+    std::vector<float> gpu_frame_ms;
+    // Keyed by zone path, one sample per frame the zone was active in.
+    std::map<std::string, std::vector<float>> zone_gpu_ms;
+    std::map<std::string, std::vector<float>> zone_cpu_ms;
+
+  public:
+    explicit Benchmark(int warmup_frames);
+
+    // Call once per frame, measures the wall clock time between calls.
+    void frame();
+    void record(const ProfiledFrame &frame);
+
+    // Prints frame time statistics and the per-zone breakdown to stdout.
+    void report() const;
+};
+
+} // namespace engine
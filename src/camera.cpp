@@ -54,6 +54,13 @@ void Camera::reset()
     offset = vec3{0};
 }
 
+void Camera::look_at(vec3 new_position, vec3 new_target)
+{
+    position = new_position;
+    target = new_target;
+    offset = vec3{0};
+}
+
 glm::mat4 Camera::get_view() const
 {
     return lookAt(position + offset, target + offset, up);
@@ -23,6 +23,8 @@ class Camera
     void pan(glm::vec2 delta);
     void zoom(float direction);
     void reset();
+    // Places the camera directly, discarding any panning.
+    void look_at(glm::vec3 position, glm::vec3 target);
 
     glm::mat4 get_view() const;
 };
\ No newline at end of file
@@ -14,5 +14,6 @@ const std::filesystem::path resources_path{"../resources"};
 const std::filesystem::path textures_path{resources_path / "textures"};
 const std::filesystem::path shaders_path{resources_path / "shaders"};
 const std::filesystem::path models_path{resources_path / "models"};
+const std::filesystem::path shader_cache_path{resources_path / "shader_cache"};
 
 } // namespace engine
@@ -12,6 +12,7 @@
 #include "logger.hpp"
 #include "profiler.hpp"
 #include "renderer/passes/taa.hpp"
+#include "renderer/texture_pool.hpp"
 
 using namespace engine;
 using namespace std;
@@ -70,6 +71,7 @@ void Editor::draw()
     ZoneScoped;
 
     TracyGpuZone("Editor");
+    GpuZone _("Editor");
 
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -86,21 +88,31 @@ void Editor::draw()
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
-static const char *passes[] = {
-    "Baking", "Shadow",      "Geometry", "SSAO",     "Lighting",   "Forward",
-    "SSR",    "Motion blur", "Bloom",    "Tone map", "Frame time", "Volumetric",
-};
+static void draw_zones(const vector<ProfilerZone> &zones, size_t parent)
+{
+    for (size_t i = 0; i < zones.size(); i++)
+    {
+        const auto &z = zones[i];
+        if (z.parent != parent)
+            continue;
+
+        ImGui::Text("%*s%s: %.3f / %.3f / %.3f, %.3f, %u draws, %llu tris",
+                    2 * z.depth, "", z.name.c_str(), z.gpu.mean, z.gpu.p95,
+                    z.gpu.p99, z.cpu.mean, z.draw_calls,
+                    static_cast<unsigned long long>(z.triangles));
+
+        draw_zones(zones, i);
+    }
+}
 
 void Editor::draw_profiler()
 {
-
     ImGui::Begin("Profiler");
     {
-        for (size_t i = 0; i < query_count; i++)
-        {
-            ImGui::Text("%s: %.3f ms", passes[i],
-                        static_cast<float>(profiler_zone_time(i)) / 1e6);
-        }
+        ImGui::Text("GPU mean/p95/p99, CPU mean (ms), %zu dropped frames",
+                    profiler_dropped_frames());
+
+        draw_zones(profiler_zones(), invalid_zone);
     }
     ImGui::End();
 }
@@ -155,6 +167,26 @@ void Editor::draw_renderer_menu()
                            value_ptr(renderer.camera.position));
     }
 
+    if (ImGui::CollapsingHeader("Submission"))
+    {
+        ImGui::Checkbox("Indirect draws", &renderer.ctx_r.indirect_draws);
+        ImGui::Checkbox("GPU culling", &renderer.ctx_r.gpu_culling);
+        ImGui::Checkbox("CPU culling", &renderer.ctx_r.cpu_culling);
+        ImGui::Checkbox("Clustered lights", &renderer.ctx_r.clustered_lights);
+
+        ImGui::Separator();
+
+        for (const auto &[name, buffer] :
+             {pair{"Vertices", &renderer.ctx_r.vertex_buf},
+              pair{"Indices", &renderer.ctx_r.index_buf}})
+            ImGui::Text("%s: %u / %u KiB", name,
+                        buffer->get_used_size() / 1024,
+                        buffer->get_capacity() / 1024);
+
+        if (ImGui::Button("Defragment meshes"))
+            renderer.defragment_meshes();
+    }
+
     if (ImGui::CollapsingHeader("GI"))
     {
         ImGui::SliderInt("Bounces", &bounce_count, 1, 10);
@@ -235,6 +267,26 @@ void Editor::draw_renderer_menu()
             renderer.taa.parse_params();
     }
 
+    ImGui::Checkbox("##Dynamic resolution",
+                    &renderer.dynamic_resolution.enabled);
+    ImGui::SameLine();
+    if (ImGui::CollapsingHeader("Dynamic resolution"))
+    {
+        auto &params = renderer.dynamic_resolution.params;
+
+        ImGui::SliderFloat("Target (ms)", &params.target_ms, 4.f, 50.f);
+        ImGui::SliderFloat("Min scale", &params.min_scale, 0.25f, 1.f);
+        ImGui::SliderFloat("Step", &params.step, 0.01f, 0.25f);
+        ImGui::SliderFloat("Tolerance", &params.tolerance, 0.f, 0.5f);
+        const auto render_size = renderer.ctx_v.render_size;
+        ImGui::Text("Scale: %.2f, %dx%d",
+                    renderer.dynamic_resolution.get_scale(), render_size.x,
+                    render_size.y);
+
+        if (!renderer.taa.enabled)
+            ImGui::Text("Requires TAA.");
+    }
+
     ImGui::Checkbox("##Sharpen", &renderer.sharpen.enabled);
     ImGui::SameLine();
     if (ImGui::CollapsingHeader("Sharpen"))
@@ -347,6 +399,15 @@ void Editor::draw_renderer_menu()
 
         if (ImGui::Checkbox("Full screen", &is_full_screen))
             window.set_full_screen(is_full_screen);
+
+        const auto &stats = renderer.graph.stats;
+        ImGui::Text("Passes: %u, culled: %u, barriers: %u", stats.pass_count,
+                    stats.culled_pass_count, stats.barrier_count);
+        ImGui::Text("Transient textures: %u, %.1f MiB (%.1f MiB unaliased)",
+                    stats.storage_count,
+                    static_cast<float>(stats.transient_bytes) / (1 << 20),
+                    static_cast<float>(stats.requested_bytes) / (1 << 20));
+        ImGui::Text("Pooled textures: %zu", texture_pool.texture_count());
     }
 
     if (ImGui::CollapsingHeader("Shadow mapping"))
@@ -356,6 +417,9 @@ void Editor::draw_renderer_menu()
         ImGui::Checkbox("Stabilize", &params.stabilize);
         ImGui::SliderFloat("Z-multiplier", &params.z_multiplier, 1.f, 3.f);
         ImGui::Checkbox("Cull front faces", &params.cull_front_faces);
+        ImGui::Checkbox("Cache static casters", &params.cache_static);
+        ImGui::SliderInt("Point light faces per frame",
+                         &params.omni_face_budget, 1, 96);
 
         float aspect_ratio = static_cast<float>(params.size.x) /
                              static_cast<float>(params.size.y);
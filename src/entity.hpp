@@ -15,6 +15,8 @@ struct Entity
     {
         none = 0,
         casts_shadow = 1 << 0,
+        // Moves or animates, kept out of cached shadow maps.
+        dynamic = 1 << 1,
     };
 
     Flags flags = Flags::none;
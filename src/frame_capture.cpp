@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <fmt/format.h>
+#include <stb_image_write.h>
+
+#include "frame_capture.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+
+using namespace engine;
+using namespace glm;
+using namespace std;
+
+using std::filesystem::path;
+
+// Only reached if the GPU hangs, waits elsewhere are for work already done.
+constexpr uint64_t fence_timeout_ns = 1'000'000'000;
+
+// Writes are waited for once this many per thread are queued, so a slow disk
+// doesn't grow the queue without bound.
+constexpr size_t writes_per_thread = 2;
+
+FrameCapture::FrameCapture(path directory)
+    : directory(std::move(directory)),
+      // Leave a core for the render thread.
+      pool(std::max(2u, thread::hardware_concurrency()) - 1)
+{
+    error_code error;
+    filesystem::create_directories(this->directory, error);
+    if (error)
+        logger.error("Failed to create capture directory {}: {}",
+                     this->directory.string(), error.message());
+
+    // GL rows run from bottom to top.
+    stbi_flip_vertically_on_write(true);
+}
+
+FrameCapture::~FrameCapture()
+{
+    flush();
+    delete_buffers();
+
+    for (auto &write : writes)
+        write.wait();
+}
+
+void FrameCapture::create_buffers(ivec2 size)
+{
+    this->size = size;
+
+    const GLbitfield flags =
+        GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr byte_size = 4 * size.x * size.y;
+
+    for (auto &slot : slots)
+    {
+        glCreateBuffers(1, &slot.buffer);
+        // Client storage hints the driver to keep the pixels in system
+        // memory, where the CPU reads them.
+        glNamedBufferStorage(slot.buffer, byte_size, nullptr,
+                             flags | GL_CLIENT_STORAGE_BIT);
+        slot.data = static_cast<const uint8_t *>(
+            glMapNamedBufferRange(slot.buffer, 0, byte_size, flags));
+    }
+}
+
+void FrameCapture::delete_buffers()
+{
+    for (auto &slot : slots)
+    {
+        if (slot.buffer == 0)
+            continue;
+
+        glUnmapNamedBuffer(slot.buffer);
+        glDeleteBuffers(1, &slot.buffer);
+        slot = {};
+    }
+}
+
+bool FrameCapture::retire(Slot &slot, bool wait)
+{
+    const auto result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                         wait ? fence_timeout_ns : 0);
+    if (result == GL_TIMEOUT_EXPIRED && !wait)
+        return false;
+    if (result == GL_WAIT_FAILED || result == GL_TIMEOUT_EXPIRED)
+        logger.error("Frame capture fence wait failed");
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    // The slot is reused in a few frames, the pool works on a copy.
+    vector<uint8_t> pixels(4 * size.x * size.y);
+    memcpy(pixels.data(), slot.data, pixels.size());
+
+    if (writes.size() >= writes_per_thread * pool.size())
+    {
+        writes.front().wait();
+        writes.pop_front();
+    }
+
+    writes.push_back(pool.submit(
+        [pixels = std::move(pixels), size = size,
+         file = directory / fmt::format("frame_{:05}.png", slot.index)]
+        {
+            if (stbi_write_png(file.string().c_str(), size.x, size.y, 4,
+                               pixels.data(), 4 * size.x))
+                return true;
+
+            logger.error("Failed to write {}", file.string());
+            return false;
+        }));
+
+    return true;
+}
+
+// Retires all slots in flight, oldest first.
+void FrameCapture::flush()
+{
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        auto &slot = slots[(next_slot + i) % slots.size()];
+        if (slot.fence != nullptr)
+            retire(slot, true);
+    }
+}
+
+void FrameCapture::capture(uint frame_buf, ivec2 size)
+{
+    GpuZone _("Capture");
+
+    // Copies that finished since the last frame, in order.
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        auto &slot = slots[(next_slot + i) % slots.size()];
+        if (slot.fence != nullptr && !retire(slot, false))
+            break;
+    }
+
+    if (size != this->size)
+    {
+        flush();
+        delete_buffers();
+        create_buffers(size);
+    }
+
+    auto &slot = slots[next_slot];
+    if (slot.fence != nullptr)
+        retire(slot, true);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, frame_buf);
+    glReadBuffer(frame_buf == default_frame_buffer_id ? GL_BACK
+                                                      : GL_COLOR_ATTACHMENT0);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    // With a pack buffer bound, the pointer is an offset into it and the call
+    // returns without waiting for the frame.
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.index = frame_idx++;
+
+    next_slot = (next_slot + 1) % slots.size();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "constants.hpp"
+#include "thread_pool.hpp"
+
+namespace engine
+{
+
+// Saves rendered frames as numbered PNG files without stalling the GPU. Each
+// frame is copied into a pixel buffer object and fenced. The pixels are read
+// on the CPU a few frames later, once the copy is done. PNG encoding happens
+// on a thread pool.
+class FrameCapture
+{
+    // Frames of pixel buffers in flight. A frame is waited for only if the GPU
+    // is this many frames behind.
+    static constexpr size_t slot_count = 3;
+
+    struct Slot
+    {
+        uint buffer = 0;
+        // Persistently mapped, see GL_MAP_PERSISTENT_BIT.
+        const uint8_t *data = nullptr;
+        GLsync fence = nullptr;
+        uint64_t index = 0;
+    };
+
+    std::filesystem::path directory;
+    glm::ivec2 size{0};
+    std::array<Slot, slot_count> slots{};
+    // Index of the slot the next frame is copied into.
+    size_t next_slot = 0;
+    uint64_t frame_idx = 0;
+
+    ThreadPool pool;
+    // Writes that haven't finished, in submission order.
+    std::deque<std::future<bool>> writes;
+
+    void create_buffers(glm::ivec2 size);
+    void delete_buffers();
+    // Hands the slot's pixels to the pool. Blocks until the copy is done when
+    // wait is set, otherwise returns false if it isn't.
+    bool retire(Slot &slot, bool wait);
+    void flush();
+
+  public:
+    // Needs a current GL context.
+    explicit FrameCapture(std::filesystem::path directory);
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+    FrameCapture(FrameCapture &&) = delete;
+    FrameCapture &operator=(FrameCapture &&) = delete;
+
+    // Queues a copy of the first color attachment of the framebuffer, or of
+    // the back buffer for the default framebuffer. Call after the frame's
+    // commands are submitted.
+    void capture(uint frame_buf, glm::ivec2 size);
+};
+
+} // namespace engine
@@ -0,0 +1,97 @@
+#include <cassert>
+#include <string>
+
+#include <glad/glad.h>
+
+#include "gl_loader.hpp"
+#include "logger.hpp"
+#include "shader.hpp"
+
+using namespace std;
+using namespace engine;
+
+bool engine::load_gl(GLADloadproc load)
+{
+    if (!gladLoadGLLoader(load))
+        return false;
+
+    // Enable error callback.
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageCallback(
+        [](GLenum source, GLenum type, GLuint id, GLenum severity,
+           GLsizei length, GLchar const *message, void const *user_param)
+        {
+            const string source_string{[&source]
+                                       {
+                                           switch (source)
+                                           {
+                                           case GL_DEBUG_SOURCE_API:
+                                               return "API";
+                                           case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+                                               return "Window system";
+                                           case GL_DEBUG_SOURCE_SHADER_COMPILER:
+                                               return "Shader compiler";
+                                           case GL_DEBUG_SOURCE_THIRD_PARTY:
+                                               return "Third party";
+                                           case GL_DEBUG_SOURCE_APPLICATION:
+                                               return "Application";
+                                           case GL_DEBUG_SOURCE_OTHER:
+                                               return "";
+                                           default:
+                                               assert(false);
+                                           }
+                                       }()};
+
+            const string type_string{[&type]
+                                     {
+                                         switch (type)
+                                         {
+                                         case GL_DEBUG_TYPE_ERROR:
+                                             return "Error";
+                                         case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+                                             return "Deprecated behavior";
+                                         case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+                                             return "Undefined behavior";
+                                         case GL_DEBUG_TYPE_PORTABILITY:
+                                             return "Portability";
+                                         case GL_DEBUG_TYPE_PERFORMANCE:
+                                             return "Performance";
+                                         case GL_DEBUG_TYPE_MARKER:
+                                             return "Marker";
+                                         case GL_DEBUG_TYPE_OTHER:
+                                             return "";
+                                         default:
+                                             assert(false);
+                                         }
+                                     }()};
+
+            const auto log_type = [&severity]
+            {
+                switch (severity)
+                {
+                case GL_DEBUG_SEVERITY_NOTIFICATION:
+                    return LogType::info;
+                case GL_DEBUG_SEVERITY_LOW:
+                    return LogType::warning;
+                case GL_DEBUG_SEVERITY_MEDIUM:
+                case GL_DEBUG_SEVERITY_HIGH:
+                    return LogType::error;
+                default:
+                    assert(false);
+                }
+            }();
+
+            logger.log(log_type, "OpenGL {0} {1}: {3}", type_string,
+                       source_string, id, message);
+        },
+        nullptr);
+
+    // Disable shader compiler spam.
+    glDebugMessageControl(GL_DEBUG_SOURCE_SHADER_COMPILER, GL_DEBUG_TYPE_OTHER,
+                          GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, false);
+
+    Shader::enable_parallel_compile(load);
+
+    return true;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace engine
+{
+
+// Loads the GL functions of the context current on this thread through the
+// given loader, and routes debug output to the logger.
+bool load_gl(GLADloadproc load);
+
+} // namespace engine
@@ -1,16 +1,41 @@
+#include <condition_variable>
 #include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string_view>
+
+#include <Tracy.hpp>
 #include <glm/ext.hpp>
 #include <glm/glm.hpp>
-#include <optional>
 
 #include "constants.hpp"
 #include "importer.hpp"
 #include "logger.hpp"
 #include "model.hpp"
+#include "thread_pool.hpp"
 
 using namespace engine;
 using namespace std;
 
+// Buffers stored in separate files, the mesh cache goes stale when they
+// change.
+static vector<filesystem::path> external_buffers(const cgltf_data &gltf,
+                                                 const filesystem::path &folder)
+{
+    vector<filesystem::path> paths;
+
+    for (size_t i = 0; i < gltf.buffers_count; i++)
+    {
+        const char *uri = gltf.buffers[i].uri;
+        if (uri != nullptr && string_view(uri).substr(0, 5) != "data:")
+            paths.push_back(folder / uri);
+    }
+
+    return paths;
+}
+
 GltfImporter::GltfImporter(const std::filesystem::path &path,
                            Renderer &renderer)
     : path(path), renderer(renderer)
@@ -30,17 +55,65 @@ optional<ImportError> GltfImporter::import()
     cgltf_result result =
         cgltf_parse_file(&options, path.string().c_str(), &gltf);
 
+    auto cache_path = path;
+    cache_path.replace_extension("mesh_cache");
+
+    vector<filesystem::path> dependencies;
+    if (result == cgltf_result_success)
+        dependencies = external_buffers(*gltf, folder);
+
+    optional<MeshCache> cache;
+    if (result == cgltf_result_success && use_mesh_cache)
+        cache = MeshCache::open(cache_path, path, dependencies);
+
+    // With a valid cache, buffers are only needed for embedded images.
+    bool needs_buffers = !cache.has_value();
     if (result == cgltf_result_success)
+        for (size_t i = 0; i < gltf->images_count; i++)
+            needs_buffers |= gltf->images[i].buffer_view != nullptr;
+
+    if (result == cgltf_result_success && needs_buffers)
         result = cgltf_load_buffers(&options, gltf, path.string().c_str());
 
     if (result == cgltf_result_success)
         result = cgltf_validate(gltf);
 
-    images.resize(gltf->images_count, invalid_texture_id);
-
     if (result == cgltf_result_success)
-        for (size_t i = 0; i < gltf->scenes_count; i++)
-            process_scene(gltf->scenes[i]);
+    {
+        images.resize(gltf->images_count, invalid_texture_id);
+        images_loaded.resize(gltf->images_count, false);
+
+        if (parallel_decode)
+            decode_images();
+
+        if (cache)
+        {
+            logger.info("Using mesh cache at path: {}", cache_path.string());
+            process_cache(*cache);
+        }
+        else
+        {
+            if (use_mesh_cache)
+                cache_data.emplace();
+
+            for (size_t i = 0; i < gltf->scenes_count; i++)
+                process_scene(gltf->scenes[i]);
+
+            if (cache_data)
+            {
+                for (size_t i = 0; i < gltf->materials_count; i++)
+                    cache_data->materials.push_back(
+                        cache_material(gltf->materials[i]));
+
+                if (MeshCache::write(cache_path, path, dependencies,
+                                     *cache_data))
+                    logger.info("Wrote mesh cache at path: {}",
+                                cache_path.string());
+
+                cache_data.reset();
+            }
+        }
+    }
 
     cgltf_free(gltf);
 
@@ -49,6 +122,38 @@ optional<ImportError> GltfImporter::import()
     return nullopt;
 }
 
+void GltfImporter::process_cache(const MeshCache &cache)
+{
+    ZoneScoped;
+
+    vector<Material> materials;
+    materials.reserve(cache.materials().size());
+
+    for (const auto &material : cache.materials())
+        materials.push_back(process_material(material));
+
+    // Upload straight from the mapping.
+    vector<size_t> mesh_indices;
+    mesh_indices.reserve(cache.meshes().size());
+
+    for (const auto &mesh : cache.meshes())
+        mesh_indices.push_back(renderer.register_mesh(
+            cache.vertices().subspan(mesh.vertex_offset, mesh.vertex_count),
+            cache.indices().subspan(mesh.index_offset, mesh.index_count),
+            Aabb{mesh.bounds_min, mesh.bounds_max}));
+
+    for (const auto &entity : cache.entities())
+    {
+        models.push_back(Entity{
+            static_cast<Entity::Flags>(entity.flags),
+            mesh_indices[entity.mesh_index],
+            entity.model,
+            entity.material_index >= 0 ? materials[entity.material_index]
+                                       : Material{},
+        });
+    }
+}
+
 void GltfImporter::process_scene(const cgltf_scene &scene)
 {
 
@@ -82,6 +187,22 @@ void GltfImporter::process_mesh(const cgltf_mesh &mesh,
         {
             auto m = process_triangles(primitive);
             m.model = transform;
+
+            if (cache_data)
+            {
+                cache_data->entities.push_back(CachedEntity{
+                    .model = transform,
+                    .flags = m.flags,
+                    .mesh_index =
+                        static_cast<uint32_t>(cache_data->meshes.size() - 1),
+                    .material_index =
+                        primitive.material
+                            ? static_cast<int32_t>(primitive.material -
+                                                   gltf->materials)
+                            : -1,
+                });
+            }
+
             models.emplace_back(move(m));
             break;
         }
@@ -103,6 +224,7 @@ Entity GltfImporter::process_triangles(const cgltf_primitive &triangles)
     vector<glm::vec3> normals;
     vector<glm::vec2> tex_coords;
     vector<glm::vec4> tangents;
+    optional<Aabb> bounds;
 
     for (size_t i = 0; i < triangles.attributes_count; i++)
     {
@@ -114,6 +236,11 @@ Entity GltfImporter::process_triangles(const cgltf_primitive &triangles)
         case cgltf_attribute_type_position:
         {
             process_attribute_accessor(accessor, positions);
+
+            // Required by the spec, but not always present.
+            if (accessor.has_min && accessor.has_max)
+                bounds = Aabb{glm::make_vec3(accessor.min),
+                              glm::make_vec3(accessor.max)};
             break;
         }
         case cgltf_attribute_type_normal:
@@ -167,14 +294,45 @@ Entity GltfImporter::process_triangles(const cgltf_primitive &triangles)
 
     auto indices = process_index_accessor(*triangles.indices);
 
+    if (!bounds)
+    {
+        bounds = Aabb{positions.empty() ? glm::vec3(0.f) : positions[0],
+                      positions.empty() ? glm::vec3(0.f) : positions[0]};
+
+        for (const auto &p : positions)
+        {
+            bounds->min = glm::min(bounds->min, p);
+            bounds->max = glm::max(bounds->max, p);
+        }
+    }
+
+    if (cache_data)
+    {
+        cache_data->meshes.push_back(CachedMesh{
+            .vertex_offset = static_cast<uint32_t>(cache_data->vertices.size()),
+            .vertex_count = static_cast<uint32_t>(vertices.size()),
+            .index_offset = static_cast<uint32_t>(cache_data->indices.size()),
+            .index_count = static_cast<uint32_t>(indices.size()),
+            .bounds_min = bounds->min,
+            .bounds_max = bounds->max,
+        });
+
+        cache_data->vertices.insert(cache_data->vertices.end(),
+                                    vertices.begin(), vertices.end());
+        cache_data->indices.insert(cache_data->indices.end(), indices.begin(),
+                                   indices.end());
+    }
+
     size_t mesh_idx =
-        renderer.register_mesh(Mesh{move(vertices), move(indices)});
+        renderer.register_mesh(Mesh{move(vertices), move(indices), bounds});
 
     return Entity{
         Entity::Flags::casts_shadow,
         mesh_idx,
         glm::mat4(1.),
-        triangles.material ? process_material(*triangles.material) : Material{},
+        triangles.material
+            ? process_material(cache_material(*triangles.material))
+            : Material{},
     };
 }
 
@@ -231,30 +389,133 @@ int GltfImporter::get_image_index(cgltf_image *image)
     return (int)(image - gltf->images);
 }
 
-uint GltfImporter::load_texture_cache(const cgltf_texture_view &texture_view)
+int GltfImporter::get_texture_index(const cgltf_texture_view &texture_view)
 {
     if (texture_view.texture == nullptr)
+        return -1;
+
+    return (int)(texture_view.texture - gltf->textures);
+}
+
+uint GltfImporter::load_texture_cache(int texture_idx)
+{
+    if (texture_idx < 0 ||
+        static_cast<cgltf_size>(texture_idx) >= gltf->textures_count)
         return invalid_texture_id;
 
-    int idx = get_image_index(texture_view.texture->image);
+    const auto &texture = gltf->textures[texture_idx];
+
+    if (texture.image == nullptr)
+        return invalid_texture_id;
+
+    int idx = get_image_index(texture.image);
 
     // Image was already loaded.
-    if (uint cached = images[idx]; cached != invalid_texture_id)
+    if (images_loaded[idx])
+        return images[idx];
+
+    uint id = process_texture(texture);
+    images[idx] = id;
+    images_loaded[idx] = true;
+
+    return id;
+}
+
+void GltfImporter::decode_images()
+{
+    ZoneScoped;
+
+    // Samplers belong to textures, while the cache is keyed on images. The
+    // first texture referencing an image decides its sampler, like it does
+    // when loading lazily.
+    vector<Sampler> samplers(gltf->images_count);
+    vector<bool> has_sampler(gltf->images_count, false);
+
+    for (size_t i = 0; i < gltf->textures_count; i++)
     {
-        return cached;
+        const auto &texture = gltf->textures[i];
+
+        if (texture.image == nullptr)
+            continue;
+
+        int idx = get_image_index(texture.image);
+
+        if (!has_sampler[idx])
+        {
+            samplers[idx] = texture.sampler == nullptr
+                                ? Sampler{}
+                                : process_sampler(*texture.sampler);
+            has_sampler[idx] = true;
+        }
     }
 
-    uint texture = process_texture_view(texture_view);
-    images[idx] = texture;
+    mutex done_mutex;
+    condition_variable done_cv;
+    queue<pair<size_t, DecodedImage>> done;
+
+    // Declared last so the workers are joined before the queue is destroyed.
+    ThreadPool pool;
+
+    // Images no texture references are never loaded.
+    size_t image_count = 0;
+
+    for (size_t i = 0; i < gltf->images_count; i++)
+    {
+        if (!has_sampler[i])
+            continue;
+
+        image_count++;
 
-    return texture;
+        pool.submit(
+            [&, i]
+            {
+                // Every image must be reported, the GL thread waits for all
+                // of them.
+                DecodedImage image;
+                try
+                {
+                    image = decode_image(gltf->images[i], samplers[i]);
+                }
+                catch (const exception &e)
+                {
+                    logger.error("Failed to decode image {}: {}", i,
+                                 e.what());
+                }
+                catch (...)
+                {
+                    logger.error("Failed to decode image {}", i);
+                }
+
+                {
+                    lock_guard lock(done_mutex);
+                    done.emplace(i, std::move(image));
+                }
+
+                done_cv.notify_one();
+            });
+    }
+
+    // Upload on the GL thread in the order the workers finish.
+    for (size_t i = 0; i < image_count; i++)
+    {
+        unique_lock lock(done_mutex);
+        done_cv.wait(lock, [&] { return !done.empty(); });
+
+        auto [idx, image] = std::move(done.front());
+        done.pop();
+        lock.unlock();
+
+        images[idx] = upload_image(image);
+        images_loaded[idx] = true;
+    }
+
+    logger.info("Decoded {} images using {} threads.", image_count,
+                pool.size());
 }
 
-uint GltfImporter::process_texture_view(const cgltf_texture_view &texture_view)
+GltfImporter::DecodedImage
+GltfImporter::decode_image(const cgltf_image &image, Sampler sampler) const
 {
-    const auto &texture = *texture_view.texture;
-    const auto &image = *texture.image;
-
     constexpr bool find_dds = true;
 
     if (image.uri && find_dds)
@@ -267,12 +528,10 @@ uint GltfImporter::process_texture_view(const cgltf_texture_view &texture_view)
                 .c_str());
 
         if (!tex.empty())
-            return get<unsigned int>(renderer.register_texture(tex));
+            return tex;
     }
 
-    auto sampler = texture.sampler == nullptr
-                       ? Sampler{}
-                       : process_sampler(*texture.sampler);
+    optional<Texture> tex;
 
     if (image.buffer_view)
     {
@@ -281,41 +540,61 @@ uint GltfImporter::process_texture_view(const cgltf_texture_view &texture_view)
 
         uint8_t *buffer_data = (uint8_t *)buffer.data + buffer_view.offset;
 
-        return get<uint>(renderer.register_texture(*Texture::from_memory(
-            buffer_data, static_cast<int>(buffer_view.size), sampler)));
+        tex = Texture::from_memory(
+            buffer_data, static_cast<int>(buffer_view.size), sampler);
     }
     else
     {
-        return get<uint>(renderer.register_texture(*Texture::from_file(
-            std::filesystem::path(folder / image.uri), sampler)));
+        tex = Texture::from_file(std::filesystem::path(folder / image.uri),
+                                 sampler);
     }
 
+    if (!tex)
+        return monostate{};
+
+    return std::move(*tex);
+}
+
+uint GltfImporter::upload_image(const DecodedImage &image)
+{
+    if (const auto *tex = get_if<Texture>(&image))
+        return get<uint>(renderer.register_texture(*tex));
+
+    if (const auto *tex = get_if<CompressedTexture>(&image))
+        return get<uint>(renderer.register_texture(*tex));
+
     return invalid_texture_id;
 }
 
-Material GltfImporter::process_material(const cgltf_material &gltf_material)
+uint GltfImporter::process_texture(const cgltf_texture &texture)
 {
-    Material material;
+    auto sampler = texture.sampler == nullptr
+                       ? Sampler{}
+                       : process_sampler(*texture.sampler);
 
-    material.normal = load_texture_cache(gltf_material.normal_texture);
-    //    material.emissive =
-    //    process_texture_view(gltf_material.emissive_texture);
-    //    material.occlusion =
-    //    process_texture_view(gltf_material.occlusion_texture);
+    return upload_image(decode_image(*texture.image, sampler));
+}
 
-    material.alpha_mode = (AlphaMode)gltf_material.alpha_mode;
-    if (material.alpha_mode == AlphaMode::mask)
+CachedMaterial
+GltfImporter::cache_material(const cgltf_material &gltf_material)
+{
+    CachedMaterial material;
+
+    material.normal = get_texture_index(gltf_material.normal_texture);
+
+    material.alpha_mode = gltf_material.alpha_mode;
+    if (material.alpha_mode == static_cast<int32_t>(AlphaMode::mask))
         material.alpha_cutoff = gltf_material.alpha_cutoff;
 
     if (gltf_material.has_pbr_metallic_roughness)
     {
         const auto &gltf_pbr = gltf_material.pbr_metallic_roughness;
 
-        material.base_color = load_texture_cache(gltf_pbr.base_color_texture);
+        material.base_color = get_texture_index(gltf_pbr.base_color_texture);
         material.metallic_roughness =
-            load_texture_cache(gltf_pbr.metallic_roughness_texture);
+            get_texture_index(gltf_pbr.metallic_roughness_texture);
 
-        if (material.base_color == invalid_texture_id)
+        if (material.base_color == -1)
             material.base_color_factor =
                 glm::make_vec4(gltf_pbr.base_color_factor);
 
@@ -329,3 +608,27 @@ Material GltfImporter::process_material(const cgltf_material &gltf_material)
 
     return material;
 }
+
+Material GltfImporter::process_material(const CachedMaterial &cached)
+{
+    Material material;
+
+    material.normal = load_texture_cache(cached.normal);
+    //    material.emissive =
+    //    process_texture_view(gltf_material.emissive_texture);
+    //    material.occlusion =
+    //    process_texture_view(gltf_material.occlusion_texture);
+
+    material.alpha_mode = static_cast<AlphaMode>(cached.alpha_mode);
+    if (material.alpha_mode == AlphaMode::mask)
+        material.alpha_cutoff = cached.alpha_cutoff;
+
+    material.base_color = load_texture_cache(cached.base_color);
+    material.metallic_roughness = load_texture_cache(cached.metallic_roughness);
+
+    material.base_color_factor = cached.base_color_factor;
+    material.metallic_factor = cached.metallic_factor;
+    material.roughness_factor = cached.roughness_factor;
+
+    return material;
+}
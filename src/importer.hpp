@@ -1,7 +1,10 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
+#include <variant>
 
+#include "mesh_cache.hpp"
 #include "model.hpp"
 #include "renderer/renderer.hpp"
 
@@ -10,7 +13,15 @@ namespace engine
 
 class GltfImporter
 {
+    // Result of decoding a single glTF image, either a DDS replacement or a
+    // regular PNG/JPEG image. Empty when decoding failed.
+    using DecodedImage =
+        std::variant<std::monostate, Texture, CompressedTexture>;
+
     std::vector<uint> images;
+    // Images that were decoded, successfully or not, so failures aren't
+    // retried.
+    std::vector<bool> images_loaded;
 
     cgltf_data *gltf = nullptr;
 
@@ -18,15 +29,25 @@ class GltfImporter
     std::filesystem::path folder;
     Renderer &renderer;
 
+    // Filled during a regular import when the mesh cache should be written.
+    std::optional<MeshCacheData> cache_data;
+
     int get_image_index(cgltf_image *image);
+    int get_texture_index(const cgltf_texture_view &texture_view);
 
+    void decode_images();
+    DecodedImage decode_image(const cgltf_image &image, Sampler sampler) const;
+    uint upload_image(const DecodedImage &image);
+
+    void process_cache(const MeshCache &cache);
     void process_scene(const cgltf_scene &scene);
     void process_node(const cgltf_node &node);
     void process_mesh(const cgltf_mesh &mesh, const glm::mat4 transform);
     Entity process_triangles(const cgltf_primitive &triangles);
-    Material process_material(const cgltf_material &gltf_material);
-    uint process_texture_view(const cgltf_texture_view &texture_view);
-    uint load_texture_cache(const cgltf_texture_view &texture_view);
+    CachedMaterial cache_material(const cgltf_material &gltf_material);
+    Material process_material(const CachedMaterial &cached);
+    uint process_texture(const cgltf_texture &texture);
+    uint load_texture_cache(int texture_idx);
     Sampler process_sampler(const cgltf_sampler &sampler);
 
     std::vector<uint32_t>
@@ -37,6 +58,13 @@ class GltfImporter
                                     std::vector<T> &vec);
 
   public:
+    // Decode all images on a thread pool up front, instead of one at a time
+    // on the GL thread when a material first references them.
+    bool parallel_decode = true;
+    // Load vertex and index streams from a memory-mapped cache next to the
+    // model, and write one after importing when it's missing or stale.
+    bool use_mesh_cache = true;
+
     std::vector<Entity> models;
     GltfImporter(const std::filesystem::path &path, Renderer &renderer);
     std::optional<ImportError> import();
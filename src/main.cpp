@@ -1,14 +1,23 @@
 #include <filesystem>
+#include <optional>
+#include <string>
 
 #include <cxxopts.hpp>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <stb_image_write.h>
 
+#include "benchmark.hpp"
 #include "editor.hpp"
 #include "entity.hpp"
+#include "frame_capture.hpp"
 #include "importer.hpp"
 #include "logger.hpp"
+#include "offscreen_context.hpp"
+#include "profiler.hpp"
 #include "renderer/renderer.hpp"
+#include "shader_watcher.hpp"
+#include "telemetry.hpp"
 #include "window.hpp"
 
 using std::filesystem::path;
@@ -36,24 +45,78 @@ int main(int argc, char **argv)
          cxxopts::value<float>()->default_value(("0")))
         ("cam_look_z", "Camera look z component",
          cxxopts::value<float>()->default_value(("0")))
-        ("bake", "Bake irradiance probes");
+        ("bake", "Bake irradiance probes")
+        ("telemetry", "Record zone timings and draw counts to a .json "
+         "(Chrome trace) or .csv file", cxxopts::value<string>())
+        ("capture", "Save every rendered frame as a numbered .png file to a "
+         "directory", cxxopts::value<string>())
+        ("scene", "glTF scene to load",
+         cxxopts::value<string>()->default_value(
+             (models_path / "sponza/Sponza.gltf").string()))
+        ("benchmark", "Play back a camera path file offscreen and report "
+         "frame times", cxxopts::value<string>())
+        ("screenshot", "Render offscreen and save the frame after the warmup "
+         "frames to a .png file", cxxopts::value<string>())
+        ("frames", "Benchmark frames to measure",
+         cxxopts::value<int>()->default_value("1000"))
+        ("warmup", "Frames to render before measuring or taking the "
+         "screenshot",
+         cxxopts::value<int>()->default_value("30"));
     // clang-format on
 
     auto result = options.parse(argc, argv);
 
-    if (!Window::init_glfw())
+    optional<CameraPath> camera_path;
+    if (result.count("benchmark"))
     {
-        logger.error("GLFW initialization failed");
-        return EXIT_FAILURE;
+        camera_path = CameraPath::load(result["benchmark"].as<string>());
+        if (!camera_path)
+            return EXIT_FAILURE;
     }
 
+    const bool benchmarking = camera_path.has_value();
+    const bool screenshot = result.count("screenshot") > 0;
+    // Runs that don't take input render without a window, so they also work
+    // without a display server.
+    const bool headless = benchmarking || screenshot;
+    const int measured_frames = result["frames"].as<int>();
+    const int warmup_frames = result["warmup"].as<int>();
+
     ivec2 size{1600, 900};
-    Window window(size, "engine");
 
-    if (!Window::init_gl())
+    optional<OffscreenContext> offscreen;
+    optional<Window> window;
+
+    if (headless)
     {
-        logger.error("OpenGL initialization failed");
-        return EXIT_FAILURE;
+        offscreen.emplace();
+        if (!offscreen->is_valid())
+        {
+            logger.error("EGL initialization failed");
+            return EXIT_FAILURE;
+        }
+
+        if (!offscreen->init_gl())
+        {
+            logger.error("OpenGL initialization failed");
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        if (!Window::init_glfw())
+        {
+            logger.error("GLFW initialization failed");
+            return EXIT_FAILURE;
+        }
+
+        window.emplace(size, "engine");
+
+        if (!Window::init_gl())
+        {
+            logger.error("OpenGL initialization failed");
+            return EXIT_FAILURE;
+        }
     }
 
     Renderer renderer(size,
@@ -63,14 +126,48 @@ int main(int argc, char **argv)
                       glm::vec3(result["cam_look_x"].as<float>(),
                                 result["cam_look_y"].as<float>(),
                                 result["cam_look_z"].as<float>()));
-    Editor editor(window, renderer);
 
-    window.add_mouse_scroll_callback([&renderer](double, double offset)
-                                     { renderer.camera.zoom(offset); });
-    window.add_key_callback(GLFW_KEY_ESCAPE,
-                            [&window](int, int) { window.close(); });
-    window.add_key_callback(GLFW_KEY_C,
-                            [&renderer](int, int) { renderer.camera.reset(); });
+    // Headless runs don't watch shaders, so they stay reproducible.
+    optional<Editor> editor;
+    optional<ShaderWatcher> shader_watcher;
+    if (headless)
+    {
+        renderer.enable_offscreen_target();
+    }
+    else
+    {
+        editor.emplace(*window, renderer);
+        shader_watcher.emplace(shaders_path);
+    }
+
+    optional<TelemetryRecorder> telemetry;
+    if (result.count("telemetry"))
+        telemetry.emplace(path(result["telemetry"].as<string>()));
+
+    optional<FrameCapture> capture;
+    if (result.count("capture"))
+        capture.emplace(path(result["capture"].as<string>()));
+
+    Benchmark benchmark(warmup_frames);
+
+    profiler_set_frame_callback(
+        [&](const ProfiledFrame &frame)
+        {
+            if (telemetry)
+                telemetry->record(frame);
+            if (benchmarking)
+                benchmark.record(frame);
+        });
+
+    if (window)
+    {
+        window->add_mouse_scroll_callback([&renderer](double, double offset)
+                                          { renderer.camera.zoom(offset); });
+        window->add_key_callback(GLFW_KEY_ESCAPE,
+                                 [&window](int, int) { window->close(); });
+        window->add_key_callback(
+            GLFW_KEY_C, [&renderer](int, int) { renderer.camera.reset(); });
+    }
 
     const path skybox_path = textures_path / "skybox-1";
     auto skybox_tex =
@@ -83,11 +180,7 @@ int main(int argc, char **argv)
 
     renderer.ctx_r.skybox_tex = skybox_tex;
 
-    path model = models_path / "sponza/Sponza.gltf";
-    // path model = models_path / "bistro/gltf/bistro.gltf";
-    // path model = models_path / "avocado.glb";
-    // path model = models_path / "boom_box.glb";
-    // path model = models_path / "plane.glb";
+    const path model = result["scene"].as<string>();
 
     {
         GltfImporter importer(model, renderer);
@@ -98,8 +191,8 @@ int main(int argc, char **argv)
                  back_inserter(entities));
     }
 
-    double last_time = glfwGetTime();
-    vec2 cursor_pos = window.get_cursor_position();
+    double last_time = window ? glfwGetTime() : 0.;
+    vec2 cursor_pos = window ? window->get_cursor_position() : vec2{0.f};
 
     renderer.update_vao();
 
@@ -107,33 +200,105 @@ int main(int argc, char **argv)
         renderer.prepare_bake(vec3{0.5f, 4.5f, 0.5f}, vec3{22.f, 8.f, 9.f}, 1,
                               1);
 
-    window.run(
-        [&]()
-        {
-            // Timestep.
-            float time = glfwGetTime();
-            float delta_time = time - last_time;
-            last_time = time;
+    // Fixed timestep, so every run renders the same frames. The path is
+    // played once over the measured frames.
+    const int total_frames = warmup_frames + measured_frames;
+    const float benchmark_dt =
+        benchmarking ? camera_path->duration() / std::max(measured_frames, 1)
+                     : 0.f;
+    int frame_idx = 0;
 
-            vec2 new_cursor_pos = window.get_cursor_position();
+    const auto render = [&](float delta_time)
+    {
+        renderer.render(delta_time, entities);
+
+        if (capture)
+            capture->capture(renderer.ctx_v.ldr_frame_buf, renderer.ctx_v.size);
+    };
 
-            if (glfwGetMouseButton(window.impl, GLFW_MOUSE_BUTTON_MIDDLE) ==
-                GLFW_PRESS)
+    const auto main_loop = [&]()
+    {
+        if (screenshot)
+        {
+            if (frame_idx == warmup_frames + 1)
             {
-                auto delta = cursor_pos - new_cursor_pos;
+                const auto pixels = renderer.read_ldr_pixels();
+                const auto file = result["screenshot"].as<string>();
 
-                if (glfwGetKey(window.impl, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-                    renderer.camera.pan(delta);
-                else
-                    renderer.camera.rotate(delta);
+                stbi_flip_vertically_on_write(true);
+                if (!stbi_write_png(file.c_str(), size.x, size.y, 4,
+                                    pixels.data(), 4 * size.x))
+                    logger.error("Failed to write screenshot {}", file);
+
+                offscreen->close();
+                return;
             }
 
-            cursor_pos = new_cursor_pos;
+            render(1.f / 60.f);
+            frame_idx++;
 
-            renderer.render(delta_time, entities);
+            return;
+        }
 
-            editor.draw();
-        });
+        if (benchmarking)
+        {
+            benchmark.frame();
+
+            if (frame_idx == total_frames)
+            {
+                offscreen->close();
+                return;
+            }
+
+            const float path_time =
+                std::max(frame_idx - warmup_frames, 0) * benchmark_dt;
+            const auto key = camera_path->sample(path_time);
+            renderer.camera.look_at(key.position, key.target);
+
+            render(benchmark_dt);
+            frame_idx++;
+
+            return;
+        }
+
+        // Timestep.
+        float time = glfwGetTime();
+        float delta_time = time - last_time;
+        last_time = time;
+
+        vec2 new_cursor_pos = window->get_cursor_position();
+
+        if (glfwGetMouseButton(window->impl, GLFW_MOUSE_BUTTON_MIDDLE) ==
+            GLFW_PRESS)
+        {
+            auto delta = cursor_pos - new_cursor_pos;
+
+            if (glfwGetKey(window->impl, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+                renderer.camera.pan(delta);
+            else
+                renderer.camera.rotate(delta);
+        }
+
+        cursor_pos = new_cursor_pos;
+
+        shader_watcher->poll();
+
+        render(delta_time);
+
+        editor->draw();
+    };
+
+    if (offscreen)
+        offscreen->run(main_loop);
+    else
+        window->run(main_loop);
+
+    if (benchmarking)
+    {
+        // Frames still in flight belong to the measurement.
+        profiler_flush();
+        benchmark.report();
+    }
 
     return EXIT_SUCCESS;
 }
@@ -22,4 +22,18 @@ float engine::halton(uint32_t index, uint32_t base)
     }
 
     return r;
-}
\ No newline at end of file
+}
+
+// https://github.com/erich666/GraphicsGems/blob/master/gems/TransBox.c
+engine::Aabb engine::transform_aabb(const Aabb &aabb, const mat4 &transform)
+{
+    const vec3 center = (aabb.min + aabb.max) * 0.5f;
+    const vec3 extent = (aabb.max - aabb.min) * 0.5f;
+
+    const vec3 new_center = vec3(transform * vec4(center, 1.f));
+    const mat3 abs_mat{abs(vec3(transform[0])), abs(vec3(transform[1])),
+                       abs(vec3(transform[2]))};
+    const vec3 new_extent = abs_mat * extent;
+
+    return Aabb{new_center - new_extent, new_center + new_extent};
+}
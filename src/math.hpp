@@ -7,6 +7,15 @@
 namespace engine
 {
 
+struct Aabb
+{
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+};
+
 float halton(uint32_t index, uint32_t base);
 
+// Bounds of the transformed box, without transforming all eight corners.
+Aabb transform_aabb(const Aabb &aabb, const glm::mat4 &transform);
+
 } // namespace engine
\ No newline at end of file
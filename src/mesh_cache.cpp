@@ -0,0 +1,346 @@
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <memory>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <Tracy.hpp>
+
+#include "logger.hpp"
+#include "mesh_cache.hpp"
+
+using namespace engine;
+using namespace std;
+
+using std::filesystem::path;
+
+static_assert(is_trivially_copyable_v<Vertex>);
+static_assert(is_trivially_copyable_v<CachedMesh>);
+static_assert(is_trivially_copyable_v<CachedMaterial>);
+static_assert(is_trivially_copyable_v<CachedEntity>);
+static_assert(is_trivially_copyable_v<CachedDependency>);
+
+static constexpr size_t section_count = 6;
+static constexpr size_t section_alignment = 16;
+
+static constexpr size_t align(size_t offset)
+{
+    return (offset + section_alignment - 1) & ~(section_alignment - 1);
+}
+
+static constexpr array<size_t, section_count> element_sizes{
+    sizeof(Vertex),         sizeof(uint32_t),     sizeof(CachedMesh),
+    sizeof(CachedMaterial), sizeof(CachedEntity), sizeof(CachedDependency),
+};
+
+template <typename Header>
+static array<uint64_t, section_count> counts(const Header &h)
+{
+    return {h.vertex_count,   h.index_count,  h.mesh_count,
+            h.material_count, h.entity_count, h.dependency_count};
+}
+
+// Byte offsets of the vertex, index, mesh, material, entity and dependency
+// sections, followed by the total file size.
+template <typename Header>
+static array<size_t, section_count + 1> layout(const Header &h)
+{
+    array<size_t, section_count> sizes{};
+    for (size_t i = 0; i < section_count; i++)
+        sizes[i] = counts(h)[i] * element_sizes[i];
+
+    array<size_t, section_count + 1> offsets{};
+    offsets[0] = align(sizeof(Header));
+
+    for (size_t i = 0; i < section_count; i++)
+        offsets[i + 1] = align(offsets[i] + sizes[i]);
+
+    return offsets;
+}
+
+// A missing file gets an invalid time, which never matches an existing file.
+static CachedDependency stamp(const path &file)
+{
+    error_code ec;
+    const auto time = filesystem::last_write_time(file, ec);
+    if (ec)
+        return {.time = -1};
+
+    const auto size = filesystem::file_size(file, ec);
+
+    return {
+        .time = time.time_since_epoch().count(),
+        .size = ec ? 0 : size,
+    };
+}
+
+MeshCache::MeshCache(const byte *mapping, size_t mapping_size, Header header)
+    : mapping(mapping), mapping_size(mapping_size), header(header)
+{
+}
+
+MeshCache::MeshCache(MeshCache &&other) noexcept
+    : mapping(other.mapping), mapping_size(other.mapping_size),
+      header(other.header)
+{
+    other.mapping = nullptr;
+    other.mapping_size = 0;
+}
+
+MeshCache &MeshCache::operator=(MeshCache &&other) noexcept
+{
+    swap(mapping, other.mapping);
+    swap(mapping_size, other.mapping_size);
+    swap(header, other.header);
+
+    return *this;
+}
+
+MeshCache::~MeshCache()
+{
+    if (mapping == nullptr)
+        return;
+
+#ifdef _WIN32
+    delete[] mapping;
+#else
+    munmap(const_cast<byte *>(mapping), mapping_size);
+#endif
+}
+
+MeshCache::Header MeshCache::make_header(const path &source,
+                                         const MeshCacheData &data,
+                                         size_t dependency_count)
+{
+    const auto source_stamp = stamp(source);
+
+    return Header{
+        .magic = magic,
+        .version = version,
+        .source_time = source_stamp.time,
+        .source_size = source_stamp.size,
+        .vertex_count = data.vertices.size(),
+        .index_count = data.indices.size(),
+        .mesh_count = data.meshes.size(),
+        .material_count = data.materials.size(),
+        .entity_count = data.entities.size(),
+        .dependency_count = dependency_count,
+    };
+}
+
+bool MeshCache::is_valid(const Header &header, size_t file_size,
+                         const path &source)
+{
+    if (header.magic != magic || header.version != version)
+        return false;
+
+    const auto source_stamp = stamp(source);
+    if (header.source_time != source_stamp.time ||
+        header.source_size != source_stamp.size)
+        return false;
+
+    // Bound the counts first, so the layout can't overflow.
+    for (size_t i = 0; i < section_count; i++)
+        if (counts(header)[i] > file_size / element_sizes[i])
+            return false;
+
+    return layout(header).back() == file_size;
+}
+
+bool MeshCache::dependencies_match(span<const path> dependencies) const
+{
+    const auto cached = section<CachedDependency>(5);
+    if (cached.size() != dependencies.size())
+        return false;
+
+    for (size_t i = 0; i < cached.size(); i++)
+    {
+        const auto current = stamp(dependencies[i]);
+        if (cached[i].time != current.time || cached[i].size != current.size)
+            return false;
+    }
+
+    return true;
+}
+
+bool MeshCache::contents_valid() const
+{
+    const uint64_t vertex_count = vertices().size();
+    const uint64_t index_count = indices().size();
+
+    for (const auto &mesh : meshes())
+    {
+        if (uint64_t{mesh.vertex_offset} + mesh.vertex_count > vertex_count ||
+            uint64_t{mesh.index_offset} + mesh.index_count > index_count)
+            return false;
+    }
+
+    const auto material_count = static_cast<int64_t>(materials().size());
+
+    for (const auto &entity : entities())
+    {
+        if (entity.mesh_index >= meshes().size() ||
+            entity.material_index < -1 ||
+            entity.material_index >= material_count)
+            return false;
+    }
+
+    return true;
+}
+
+optional<MeshCache> MeshCache::open(const path &cache_path,
+                                    const path &source,
+                                    span<const path> dependencies)
+{
+    ZoneScoped;
+
+    error_code ec;
+    if (!filesystem::exists(cache_path, ec) || !filesystem::exists(source, ec))
+        return nullopt;
+
+    const size_t file_size = filesystem::file_size(cache_path, ec);
+    if (ec || file_size < sizeof(Header))
+        return nullopt;
+
+#ifdef _WIN32
+    // No mmap, fall back to a single read of the whole file.
+    auto data = make_unique<byte[]>(file_size);
+    {
+        ifstream file(cache_path, ios::binary);
+        if (!file.read(reinterpret_cast<char *>(data.get()), file_size))
+            return nullopt;
+    }
+    const byte *mapping = data.release();
+#else
+    int fd = ::open(cache_path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullopt;
+
+    void *ptr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing the descriptor.
+    close(fd);
+
+    if (ptr == MAP_FAILED)
+        return nullopt;
+
+    // Streams are consumed front to back during upload.
+    madvise(ptr, file_size, MADV_SEQUENTIAL);
+
+    const byte *mapping = static_cast<const byte *>(ptr);
+#endif
+
+    Header header;
+    memcpy(&header, mapping, sizeof(Header));
+
+    // Construct first so the mapping is released on failure.
+    MeshCache cache(mapping, file_size, header);
+
+    if (!is_valid(header, file_size, source) ||
+        !cache.dependencies_match(dependencies))
+    {
+        logger.info("Mesh cache at path {} is stale.", cache_path.string());
+        return nullopt;
+    }
+
+    if (!cache.contents_valid())
+    {
+        logger.warn("Mesh cache at path {} is corrupt.", cache_path.string());
+        return nullopt;
+    }
+
+    return make_optional<MeshCache>(std::move(cache));
+}
+
+bool MeshCache::write(const path &cache_path, const path &source,
+                      span<const path> dependencies, const MeshCacheData &data)
+{
+    ZoneScoped;
+
+    const Header header = make_header(source, data, dependencies.size());
+    const auto offsets = layout(header);
+
+    ofstream file(cache_path, ios::binary | ios::trunc);
+    if (!file)
+    {
+        logger.error("Cannot open mesh cache for writing: {}",
+                     cache_path.string());
+        return false;
+    }
+
+    const auto write_at = [&file](size_t offset, const void *src, size_t size)
+    {
+        file.seekp(static_cast<streamoff>(offset));
+        file.write(static_cast<const char *>(src),
+                   static_cast<streamsize>(size));
+    };
+
+    write_at(0, &header, sizeof(Header));
+    write_at(offsets[0], data.vertices.data(),
+             data.vertices.size() * sizeof(Vertex));
+    write_at(offsets[1], data.indices.data(),
+             data.indices.size() * sizeof(uint32_t));
+    write_at(offsets[2], data.meshes.data(),
+             data.meshes.size() * sizeof(CachedMesh));
+    write_at(offsets[3], data.materials.data(),
+             data.materials.size() * sizeof(CachedMaterial));
+    write_at(offsets[4], data.entities.data(),
+             data.entities.size() * sizeof(CachedEntity));
+
+    vector<CachedDependency> stamps;
+    stamps.reserve(dependencies.size());
+    for (const auto &dependency : dependencies)
+        stamps.push_back(stamp(dependency));
+
+    write_at(offsets[5], stamps.data(),
+             stamps.size() * sizeof(CachedDependency));
+
+    // Pad the final section so the file size matches the layout.
+    const char zero = 0;
+    write_at(offsets[section_count] - 1, &zero, 1);
+
+    if (!file)
+    {
+        logger.error("Failed writing mesh cache: {}", cache_path.string());
+        return false;
+    }
+
+    return true;
+}
+
+template <typename T> span<const T> MeshCache::section(size_t idx) const
+{
+    return span<const T>(
+        reinterpret_cast<const T *>(mapping + layout(header)[idx]),
+        counts(header)[idx]);
+}
+
+span<const Vertex> MeshCache::vertices() const { return section<Vertex>(0); }
+
+span<const uint32_t> MeshCache::indices() const
+{
+    return section<uint32_t>(1);
+}
+
+span<const CachedMesh> MeshCache::meshes() const
+{
+    return section<CachedMesh>(2);
+}
+
+span<const CachedMaterial> MeshCache::materials() const
+{
+    return section<CachedMaterial>(3);
+}
+
+span<const CachedEntity> MeshCache::entities() const
+{
+    return section<CachedEntity>(4);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "model.hpp"
+
+namespace engine
+{
+
+// Offsets are relative to the start of the cache's vertex and index streams.
+struct CachedMesh
+{
+    uint32_t vertex_offset = 0;
+    uint32_t vertex_count = 0;
+    uint32_t index_offset = 0;
+    uint32_t index_count = 0;
+    glm::vec3 bounds_min{0.f};
+    glm::vec3 bounds_max{0.f};
+};
+
+// Texture indices refer to the textures array of the source glTF file, -1
+// means absent.
+struct CachedMaterial
+{
+    int32_t normal = -1;
+    int32_t base_color = -1;
+    int32_t metallic_roughness = -1;
+    int32_t alpha_mode = static_cast<int32_t>(AlphaMode::opaque);
+    glm::vec4 base_color_factor{1.f};
+    float metallic_factor = 0.f;
+    float roughness_factor = 0.f;
+    float alpha_cutoff = 0.f;
+    float _pad0 = 0.f;
+};
+
+struct CachedEntity
+{
+    glm::mat4 model{1.f};
+    uint32_t flags = 0;
+    uint32_t mesh_index = 0;
+    int32_t material_index = -1;
+    uint32_t _pad0 = 0;
+};
+
+// Modification time and size of a file the cache was built from, stored in
+// the order the dependencies are passed in.
+struct CachedDependency
+{
+    int64_t time = 0;
+    uint64_t size = 0;
+};
+
+// Everything needed to write a cache, gathered during a regular import.
+struct MeshCacheData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<CachedMesh> meshes;
+    std::vector<CachedMaterial> materials;
+    std::vector<CachedEntity> entities;
+};
+
+// Read-only view of an on-disk cache containing the final interleaved vertex
+// and index streams of an imported scene. The file is memory-mapped, so the
+// spans point directly into the mapping and can be uploaded without copies.
+// The cache is stale once the source or any of its dependencies, e.g.,
+// external .bin buffers, changes size or modification time.
+class MeshCache
+{
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        int64_t source_time;
+        uint64_t source_size;
+        uint64_t vertex_count;
+        uint64_t index_count;
+        uint64_t mesh_count;
+        uint64_t material_count;
+        uint64_t entity_count;
+        uint64_t dependency_count;
+    };
+
+    static constexpr uint32_t magic = 0x48534d45; // "EMSH"
+    static constexpr uint32_t version = 3;
+
+    const std::byte *mapping = nullptr;
+    size_t mapping_size = 0;
+
+    Header header{};
+
+    MeshCache(const std::byte *mapping, size_t mapping_size, Header header);
+
+    static Header make_header(const std::filesystem::path &source,
+                              const MeshCacheData &data,
+                              size_t dependency_count);
+    static bool is_valid(const Header &header, size_t file_size,
+                         const std::filesystem::path &source);
+    bool dependencies_match(
+        std::span<const std::filesystem::path> dependencies) const;
+    // Ranges and indices stay within the sections.
+    bool contents_valid() const;
+
+    template <typename T> std::span<const T> section(size_t idx) const;
+
+  public:
+    ~MeshCache();
+
+    MeshCache(const MeshCache &) = delete;
+    MeshCache &operator=(const MeshCache &) = delete;
+    MeshCache(MeshCache &&other) noexcept;
+    MeshCache &operator=(MeshCache &&other) noexcept;
+
+    // Returns nothing when the cache is missing, corrupt or older than the
+    // source file or its dependencies.
+    static std::optional<MeshCache>
+    open(const std::filesystem::path &cache_path,
+         const std::filesystem::path &source,
+         std::span<const std::filesystem::path> dependencies);
+    static bool write(const std::filesystem::path &cache_path,
+                      const std::filesystem::path &source,
+                      std::span<const std::filesystem::path> dependencies,
+                      const MeshCacheData &data);
+
+    std::span<const Vertex> vertices() const;
+    std::span<const uint32_t> indices() const;
+    std::span<const CachedMesh> meshes() const;
+    std::span<const CachedMaterial> materials() const;
+    std::span<const CachedEntity> entities() const;
+};
+
+} // namespace engine
@@ -13,6 +13,7 @@
 
 #include "constants.hpp"
 #include "gli/texture.hpp"
+#include "math.hpp"
 
 namespace engine
 {
@@ -65,6 +66,8 @@ struct Mesh
 {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    // Object space, computed from the vertices when absent.
+    std::optional<Aabb> bounds;
 };
 
 enum class AlphaMode
@@ -0,0 +1,206 @@
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#ifdef ENGINE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <Tracy.hpp>
+#include <TracyOpenGL.hpp>
+#include <glad/glad.h>
+
+#include "gl_loader.hpp"
+#include "logger.hpp"
+#include "offscreen_context.hpp"
+#include "profiler.hpp"
+
+using namespace engine;
+using namespace std;
+
+#ifdef ENGINE_EGL
+
+static bool has_extension(const char *extensions, const char *name)
+{
+    if (extensions == nullptr)
+        return false;
+
+    const size_t length = strlen(name);
+
+    for (const char *s = strstr(extensions, name); s != nullptr;
+         s = strstr(s + length, name))
+        if ((s == extensions || s[-1] == ' ') &&
+            (s[length] == ' ' || s[length] == '\0'))
+            return true;
+
+    return false;
+}
+
+static EGLDisplay get_display()
+{
+    const char *client_extensions =
+        eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        const auto get_platform_display =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+        if (get_platform_display != nullptr)
+            if (EGLDisplay d = get_platform_display(
+                    EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY,
+                    nullptr);
+                d != EGL_NO_DISPLAY)
+                return d;
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+OffscreenContext::OffscreenContext()
+{
+    display = get_display();
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        logger.error("EGL initialization failed ({:#x})", eglGetError());
+        display = nullptr;
+        return;
+    }
+
+    logger.info("EGL {}.{}", major, minor);
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        logger.error("EGL doesn't support desktop OpenGL");
+        return;
+    }
+
+    // clang-format off
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE,
+    };
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 6,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    // clang-format on
+
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &config_count) ||
+        config_count == 0)
+    {
+        logger.error("No suitable EGL config");
+        return;
+    }
+
+    context =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        logger.error("EGL context creation failed ({:#x})", eglGetError());
+        context = nullptr;
+        return;
+    }
+
+    if (!has_extension(eglQueryString(display, EGL_EXTENSIONS),
+                       "EGL_KHR_surfaceless_context"))
+    {
+        const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1,
+                                          EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+    }
+
+    const EGLSurface s = surface == nullptr ? EGL_NO_SURFACE : surface;
+    if (!eglMakeCurrent(display, s, s, context))
+    {
+        logger.error("Making the EGL context current failed ({:#x})",
+                     eglGetError());
+        eglDestroyContext(display, context);
+        context = nullptr;
+    }
+}
+
+OffscreenContext::~OffscreenContext()
+{
+    if (display == nullptr)
+        return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if (surface != nullptr)
+        eglDestroySurface(display, surface);
+    if (context != nullptr)
+        eglDestroyContext(display, context);
+
+    eglTerminate(display);
+}
+
+bool OffscreenContext::init_gl()
+{
+    return load_gl(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+}
+
+#else
+
+OffscreenContext::OffscreenContext()
+{
+    logger.error("Offscreen rendering needs a build with ENGINE_EGL");
+}
+
+OffscreenContext::~OffscreenContext() {}
+
+bool OffscreenContext::init_gl() { return false; }
+
+#endif
+
+bool OffscreenContext::is_valid() const { return context != nullptr; }
+
+void OffscreenContext::close() { should_close = true; }
+
+void OffscreenContext::run(const function<void()> &main_loop)
+{
+    ZoneScoped;
+
+    profiler_init();
+
+    TracyGpuContext;
+
+    // Without a swap chain nothing stops the CPU from queueing frames ahead
+    // of the GPU. Wait for the frame before the previous one, like double
+    // buffered presentation would.
+    array<GLsync, 2> fences{};
+    const uint64_t fence_timeout_ns = 1'000'000'000;
+
+    for (uint64_t frame = 0; !should_close; frame++)
+    {
+        main_loop();
+
+        auto &fence = fences[frame % fences.size()];
+        if (fence != nullptr)
+        {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                             fence_timeout_ns);
+            glDeleteSync(fence);
+        }
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        profiler_collect();
+
+        TracyGpuCollect;
+        FrameMark
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <functional>
+
+namespace engine
+{
+
+// OpenGL 4.6 core context without a window, through EGL. Mesa's surfaceless
+// platform is preferred, it needs no display server and also runs on
+// llvmpipe, other drivers get their default display. There's no default
+// framebuffer to present, see Renderer::enable_offscreen_target. Only
+// available when built with ENGINE_EGL.
+class OffscreenContext
+{
+    void *display = nullptr;
+    void *context = nullptr;
+    // A 1x1 pbuffer, for drivers without surfaceless contexts.
+    void *surface = nullptr;
+    bool should_close = false;
+
+  public:
+    OffscreenContext();
+    ~OffscreenContext();
+
+    OffscreenContext(const OffscreenContext &) = delete;
+    OffscreenContext &operator=(const OffscreenContext &) = delete;
+    OffscreenContext(OffscreenContext &&) = delete;
+    OffscreenContext &operator=(OffscreenContext &&) = delete;
+
+    bool is_valid() const;
+
+    // Loads GL functions for the context, see Window::init_gl.
+    bool init_gl();
+
+    void close();
+    // Same frame bookkeeping as Window::run, without presenting.
+    void run(const std::function<void()> &main_loop);
+};
+
+} // namespace engine
@@ -1,87 +1,346 @@
-#include <bitset>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstdint>
 #include <numeric>
 
-#include "logger.hpp"
 #include "profiler.hpp"
-#include "constants.hpp"
 
 using namespace engine;
 using namespace std;
 
-const int sample_count = 15;
+using Clock = chrono::steady_clock;
 
-struct Query
+struct Zone
 {
-    uint begin;
-    uint end;
+    string name;
+    size_t parent;
+    int depth;
+    // Rings of the latest samples in milliseconds.
+    array<float, profiler_window> gpu_samples{};
+    array<float, profiler_window> cpu_samples{};
+    size_t sample_count = 0;
+    size_t next_sample = 0;
+    uint32_t draw_calls = 0;
+    uint64_t triangles = 0;
 };
 
-std::array<std::array<Query, query_count>, 2> queries{};
-std::bitset<query_count> active_queries;
-std::array<std::array<uint64_t, sample_count>, query_count> times;
+// A zone instance within a frame, its end query follows the begin query.
+struct Entry
+{
+    size_t zone;
+    size_t query;
+    // Entry of the enclosing zone, invalid_zone at the root.
+    size_t parent;
+    Clock::time_point cpu_begin;
+    Clock::time_point cpu_end{};
+    uint32_t draw_calls = 0;
+    uint64_t triangles = 0;
+};
+
+struct Frame
+{
+    uint64_t index = 0;
+    vector<uint> queries;
+    vector<Entry> entries;
+    // Zones end in reverse order of their start, the last end query issued
+    // completes after all others.
+    size_t last_query = 0;
+    bool pending = false;
+};
+
+static vector<Zone> zones;
+// Entries of the open zones in the current frame.
+static vector<size_t> entry_stack;
+static array<Frame, profiler_frame_count> frames;
+static uint64_t frame_idx = 0;
+static size_t dropped_frames = 0;
+static function<void(const ProfiledFrame &)> frame_callback;
 
-int active = 0;
-uint counter = 0;
+static Frame &current_frame() { return frames[frame_idx % frames.size()]; }
 
-Query *front() { return queries[active].data(); }
+static size_t find_zone(string_view name, size_t parent)
+{
+    for (size_t i = 0; i < zones.size(); i++)
+        if (zones[i].parent == parent && zones[i].name == name)
+            return i;
+
+    zones.push_back({
+        .name = string(name),
+        .parent = parent,
+        .depth = parent == invalid_zone ? 0 : zones[parent].depth + 1,
+    });
 
-Query *back() { return queries[active ^ 1].data(); }
+    return zones.size() - 1;
+}
 
-void swap() { active ^= 1; }
+// Reads the frame's results if they have all arrived, or once they have when
+// waiting.
+static bool resolve(Frame &frame, bool wait = false)
+{
+    // Reading GL_QUERY_RESULT blocks until the result is available.
+    if (!frame.entries.empty() && !wait)
+    {
+        int available = 0;
+        glGetQueryObjectiv(frame.queries[frame.last_query],
+                           GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+    }
+
+    // Children are entered after their parent, accumulating in reverse
+    // makes the draw counts inclusive.
+    for (auto it = frame.entries.rbegin(); it != frame.entries.rend(); it++)
+    {
+        if (it->parent != invalid_zone)
+        {
+            frame.entries[it->parent].draw_calls += it->draw_calls;
+            frame.entries[it->parent].triangles += it->triangles;
+        }
+    }
+
+    ProfiledFrame result{.index = frame.index};
+    result.zones.reserve(frame.entries.size());
+
+    // A zone can be entered several times in a frame, its samples are the
+    // sums.
+    vector<float> gpu_ms(zones.size(), 0.f);
+    vector<float> cpu_ms(zones.size(), 0.f);
+    vector<bool> active(zones.size(), false);
+
+    for (const auto &e : frame.entries)
+    {
+        uint64_t begin, end;
+        glGetQueryObjectui64v(frame.queries[e.query], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.queries[e.query + 1], GL_QUERY_RESULT,
+                              &end);
+
+        auto &z = zones[e.zone];
+        if (!active[e.zone])
+        {
+            z.draw_calls = 0;
+            z.triangles = 0;
+            active[e.zone] = true;
+        }
+
+        gpu_ms[e.zone] += static_cast<float>(end - begin) / 1e6f;
+        cpu_ms[e.zone] +=
+            chrono::duration<float, milli>(e.cpu_end - e.cpu_begin).count();
+        z.draw_calls += e.draw_calls;
+        z.triangles += e.triangles;
+
+        result.zones.push_back({
+            .zone = e.zone,
+            .gpu_begin_ns = begin,
+            .gpu_end_ns = end,
+            .cpu_begin = e.cpu_begin,
+            .cpu_end = e.cpu_end,
+            .draw_calls = e.draw_calls,
+            .triangles = e.triangles,
+        });
+    }
+
+    for (size_t i = 0; i < zones.size(); i++)
+    {
+        if (!active[i])
+            continue;
+
+        auto &z = zones[i];
+        z.gpu_samples[z.next_sample] = gpu_ms[i];
+        z.cpu_samples[z.next_sample] = cpu_ms[i];
+        z.next_sample = (z.next_sample + 1) % profiler_window;
+        z.sample_count = std::min(z.sample_count + 1, profiler_window);
+    }
+
+    if (frame_callback)
+        frame_callback(result);
+
+    frame.entries.clear();
+    frame.pending = false;
+
+    return true;
+}
+
+static ZoneStats
+compute_stats(const array<float, profiler_window> &samples, size_t next,
+              size_t count)
+{
+    vector<float> latest(count);
+    for (size_t i = 0; i < count; i++)
+        latest[i] = samples[(next + profiler_window - count + i) %
+                            profiler_window];
+
+    return compute_zone_stats(std::move(latest));
+}
+
+ZoneStats engine::compute_zone_stats(vector<float> samples)
+{
+    if (samples.empty())
+        return {};
+
+    ranges::sort(samples);
+
+    const auto percentile = [&samples](float p)
+    {
+        const auto rank = static_cast<size_t>(
+            std::ceil(p * static_cast<float>(samples.size())));
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+
+    return {
+        .mean = accumulate(samples.begin(), samples.end(), 0.f) /
+                static_cast<float>(samples.size()),
+        .p50 = percentile(0.5f),
+        .p95 = percentile(0.95f),
+        .p99 = percentile(0.99f),
+    };
+}
 
 void engine::profiler_init()
 {
-    glGenQueries(4 * query_count, reinterpret_cast<uint *>(queries.data()));
+    zones.clear();
+    entry_stack.clear();
+    frames = {};
+    frame_idx = 0;
+    dropped_frames = 0;
 }
 
-GpuZone::GpuZone(size_t idx) : idx(idx)
+GpuZone::GpuZone(string_view name)
 {
-    glQueryCounter(back()[idx].begin, GL_TIMESTAMP);
-    active_queries[idx] = true;
+    const auto cpu_begin = Clock::now();
+
+    auto &frame = current_frame();
+
+    const size_t parent =
+        entry_stack.empty() ? invalid_zone : entry_stack.back();
+    const size_t zone =
+        find_zone(name, parent == invalid_zone ? invalid_zone
+                                               : frame.entries[parent].zone);
+
+    // Queries are pooled per frame, the pool grows to the most zones seen.
+    const size_t query = 2 * frame.entries.size();
+    if (query + 2 > frame.queries.size())
+    {
+        frame.queries.resize(query + 2);
+        glGenQueries(2, &frame.queries[query]);
+    }
+
+    glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+
+    entry = frame.entries.size();
+    frame.entries.push_back({
+        .zone = zone,
+        .query = query,
+        .parent = parent,
+        .cpu_begin = cpu_begin,
+    });
+    entry_stack.push_back(entry);
 }
 
-GpuZone::~GpuZone() { glQueryCounter(back()[idx].end, GL_TIMESTAMP); };
+GpuZone::~GpuZone()
+{
+    auto &frame = current_frame();
+    auto &e = frame.entries[entry];
+
+    glQueryCounter(frame.queries[e.query + 1], GL_TIMESTAMP);
+    frame.last_query = e.query + 1;
+
+    e.cpu_end = Clock::now();
+
+    entry_stack.pop_back();
+}
 
 void engine::profiler_collect()
 {
-    uint64_t begin, end;
+    current_frame().pending = true;
 
-    for (int i = 0; i < query_count; i++)
+    // Oldest first, so samples are pushed in frame order.
+    for (size_t i = 0; i < frames.size(); i++)
     {
-        if (active_queries[i])
-        {
-            int available = 0;
-            glGetQueryObjectiv(front()[i].end, GL_QUERY_RESULT_AVAILABLE,
-                               &available);
-            if (available)
-            {
-                glGetQueryObjectui64v(front()[i].begin, GL_QUERY_RESULT,
-                                      &begin);
-                glGetQueryObjectui64v(front()[i].end, GL_QUERY_RESULT, &end);
-
-                times[i][counter] = end - begin;
-            }
-            else
-            {
-                logger.warn("Timer query result unavailable.");
-            }
-        }
-        else
-        {
-            times[i][counter] = 0.f;
-        }
+        auto &frame = frames[(frame_idx + 1 + i) % frames.size()];
+        if (frame.pending && !resolve(frame))
+            break;
+    }
+
+    frame_idx++;
+
+    auto &frame = current_frame();
+    if (frame.pending)
+    {
+        frame.entries.clear();
+        frame.pending = false;
+        dropped_frames++;
+    }
+    frame.index = frame_idx;
+}
+
+void engine::profiler_flush()
+{
+    // The current frame is still being recorded, the others are in flight.
+    for (size_t i = 1; i < frames.size(); i++)
+    {
+        auto &frame = frames[(frame_idx + i) % frames.size()];
+        if (frame.pending)
+            resolve(frame, true);
     }
+}
+
+vector<ProfilerZone> engine::profiler_zones()
+{
+    vector<ProfilerZone> result;
+    result.reserve(zones.size());
+
+    for (const auto &z : zones)
+        result.push_back({
+            .name = z.name,
+            .parent = z.parent,
+            .depth = z.depth,
+            .gpu = compute_stats(z.gpu_samples, z.next_sample, z.sample_count),
+            .cpu = compute_stats(z.cpu_samples, z.next_sample, z.sample_count),
+            .draw_calls = z.draw_calls,
+            .triangles = z.triangles,
+        });
+
+    return result;
+}
+
+optional<ZoneStats> engine::profiler_zone_stats(string_view name,
+                                                size_t sample_count)
+{
+    const auto it = ranges::find_if(zones, [name](const Zone &z)
+                                    { return z.name == name; });
+
+    if (it == zones.end())
+        return nullopt;
+
+    return compute_stats(it->gpu_samples, it->next_sample,
+                         std::min(sample_count, it->sample_count));
+}
+
+size_t engine::profiler_dropped_frames() { return dropped_frames; }
 
-    counter = (counter + 1) % sample_count;
+string engine::profiler_zone_path(size_t zone)
+{
+    string path = zones[zone].name;
 
-    active_queries.reset();
+    for (size_t p = zones[zone].parent; p != invalid_zone; p = zones[p].parent)
+        path = zones[p].name + '/' + path;
 
-    swap();
+    return path;
 }
 
-uint64_t engine::profiler_zone_time(size_t idx)
+void engine::profiler_count_draws(uint32_t draw_calls, uint64_t triangles)
 {
-    return accumulate(times[idx].begin(), times[idx].end(), 0ul) /
-           times[idx].size();
-}
\ No newline at end of file
+    if (entry_stack.empty())
+        return;
+
+    auto &e = current_frame().entries[entry_stack.back()];
+    e.draw_calls += draw_calls;
+    e.triangles += triangles;
+}
+
+void engine::profiler_set_frame_callback(
+    function<void(const ProfiledFrame &)> callback)
+{
+    frame_callback = std::move(callback);
+}
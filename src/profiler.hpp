@@ -1,7 +1,13 @@
 #pragma once
 
-#include <array>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <glad/glad.h>
 
@@ -11,25 +17,106 @@
 namespace engine
 {
 
-constexpr size_t query_count = 12;
+// Frames of timestamp queries in flight. Results are read once the driver
+// reports them available, a frame whose results haven't arrived by the time
+// its slot comes around again is dropped instead of waited for.
+constexpr size_t profiler_frame_count = 4;
 
+// Samples kept per zone for the statistics.
+constexpr size_t profiler_window = 120;
+
+constexpr size_t invalid_zone = static_cast<size_t>(-1);
+
+// Milliseconds.
+struct ZoneStats
+{
+    float mean = 0.f;
+    float p50 = 0.f;
+    float p95 = 0.f;
+    float p99 = 0.f;
+};
+
+struct ProfilerZone
+{
+    std::string name;
+    size_t parent = invalid_zone;
+    int depth = 0;
+    ZoneStats gpu{};
+    ZoneStats cpu{};
+    // Of the latest frame the zone was active in, including its children.
+    uint32_t draw_calls = 0;
+    uint64_t triangles = 0;
+};
+
+// A zone instance in a resolved frame. Draw counts include the children.
+struct ZoneSample
+{
+    size_t zone;
+    // GPU clock, see GL_TIMESTAMP.
+    uint64_t gpu_begin_ns;
+    uint64_t gpu_end_ns;
+    std::chrono::steady_clock::time_point cpu_begin;
+    std::chrono::steady_clock::time_point cpu_end;
+    uint32_t draw_calls;
+    uint64_t triangles;
+};
+
+struct ProfiledFrame
+{
+    uint64_t index;
+    // In the order the zones were entered.
+    std::vector<ZoneSample> zones;
+};
+
+// Times the enclosed GPU commands, and the CPU time spent issuing them. Zones
+// are registered on first use and nest by scope, the same name under
+// different parents is a different zone.
 class GpuZone
 {
-    size_t idx;
+    size_t entry;
 
   public:
-    GpuZone(size_t idx);
+    GpuZone(std::string_view name);
     ~GpuZone();
+
+    GpuZone(const GpuZone &) = delete;
+    GpuZone &operator=(const GpuZone &) = delete;
 };
 
 void profiler_init();
 
-void zone_start(size_t idx);
+// Call once per frame, after the frame's commands are submitted.
+void profiler_collect();
 
-void zone_stop();
+// Reads back every frame still in flight, waiting for the GPU. Call once
+// rendering is done, e.g., before reporting results.
+void profiler_flush();
 
-void profiler_collect();
+// Zones in registration order, parents precede their children.
+std::vector<ProfilerZone> profiler_zones();
+
+// GPU statistics over the latest sample_count samples of the first zone with
+// the given name.
+std::optional<ZoneStats>
+profiler_zone_stats(std::string_view name,
+                    size_t sample_count = profiler_window);
+
+// Mean and nearest-rank percentiles.
+ZoneStats compute_zone_stats(std::vector<float> samples);
+
+// Frames whose results weren't available in time.
+size_t profiler_dropped_frames();
+
+// Names joined by '/', from the root zone down.
+std::string profiler_zone_path(size_t zone);
+
+// Adds to the counts of the innermost open zone. Triangles of draws whose
+// count is decided on the GPU are estimated from above.
+void profiler_count_draws(uint32_t draw_calls, uint64_t triangles);
 
-uint64_t profiler_zone_time(size_t idx);
+// Called with every frame once its results are read back, frames are
+// delivered in order. Pass an empty function to stop.
+void profiler_set_frame_callback(
+    std::function<void(const ProfiledFrame &)> callback);
 
-} // namespace engine
\ No newline at end of file
+} // namespace engine
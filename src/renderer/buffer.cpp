@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <glad/glad.h>
 
@@ -7,32 +8,180 @@
 using namespace std;
 using namespace engine;
 
-Buffer::Buffer(uint32_t capacity, uint32_t alignment) : capacity(capacity)
+static uint32_t align_up(uint32_t size, uint32_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+Buffer::Buffer(uint32_t capacity, uint32_t alignment)
+    : capacity(align_up(capacity, max(alignment, 1u))),
+      alignment(max(alignment, 1u))
 {
     glCreateBuffers(1, &id);
-    glNamedBufferStorage(id, capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(id, this->capacity, nullptr,
+                         GL_DYNAMIC_STORAGE_BIT);
+
+    free_ranges.emplace(0, this->capacity);
 };
 
 uint Buffer::get_id() { return id; }
 
-// TODO: Use a better allocation strategy. Allow for deallocation, and fill
-// missing gaps.
-uint32_t Buffer::allocate(const void *data, uint32_t alloc_size)
+uint32_t Buffer::get_capacity() const { return capacity; }
+
+uint32_t Buffer::get_used_size() const
+{
+    uint32_t used = 0;
+    for (const auto &[offset, range_size] : allocations)
+        used += range_size;
+
+    return used;
+}
+
+void Buffer::insert_free_range(uint32_t offset, uint32_t range_size)
 {
-    while (size + alloc_size >= capacity)
+    auto it = free_ranges.emplace(offset, range_size).first;
+
+    // Merge with the following range.
+    if (auto next = std::next(it);
+        next != free_ranges.end() && it->first + it->second == next->first)
+    {
+        it->second += next->second;
+        free_ranges.erase(next);
+    }
+
+    // Merge with the preceding range.
+    if (it != free_ranges.begin())
     {
-        capacity *= 2;
-        uint new_id;
-        glCreateBuffers(1, &new_id);
-        glNamedBufferStorage(new_id, capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
-        glCopyNamedBufferSubData(id, new_id, 0, 0, size);
-        id = new_id;
+        if (auto prev = std::prev(it); prev->first + prev->second == it->first)
+        {
+            prev->second += it->second;
+            free_ranges.erase(it);
+        }
     }
+}
+
+void Buffer::grow(uint32_t min_capacity)
+{
+    uint32_t new_capacity = capacity;
+    while (new_capacity < min_capacity)
+        new_capacity *= 2;
 
-    uint32_t offset = size;
-    glNamedBufferSubData(id, offset, alloc_size, data);
+    uint new_id;
+    glCreateBuffers(1, &new_id);
+    glNamedBufferStorage(new_id, new_capacity, nullptr,
+                         GL_DYNAMIC_STORAGE_BIT);
+    glCopyNamedBufferSubData(id, new_id, 0, 0, capacity);
+    glDeleteBuffers(1, &id);
+
+    logger.info("Buffer {} grown from {} to {} bytes.", new_id, capacity,
+                new_capacity);
+
+    insert_free_range(capacity, new_capacity - capacity);
+
+    id = new_id;
+    capacity = new_capacity;
+}
+
+uint32_t Buffer::allocate(const void *data, uint32_t data_size)
+{
+    // Only the data is uploaded, the padding stays undefined.
+    const uint32_t alloc_size = align_up(max(data_size, 1u), alignment);
+
+    // Best fit, keeps large ranges intact for large meshes.
+    auto best = free_ranges.end();
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); it++)
+    {
+        if (it->second >= alloc_size &&
+            (best == free_ranges.end() || it->second < best->second))
+            best = it;
+    }
+
+    if (best == free_ranges.end())
+    {
+        // Account for a free range at the end that the new space extends.
+        uint32_t tail = 0;
+        if (!free_ranges.empty())
+        {
+            const auto &[offset, range_size] = *free_ranges.rbegin();
+            if (offset + range_size == capacity)
+                tail = range_size;
+        }
+
+        grow(capacity - tail + alloc_size);
+        best = std::prev(free_ranges.end());
+    }
 
-    size += alloc_size;
+    auto [offset, range_size] = *best;
+    free_ranges.erase(best);
+
+    if (range_size > alloc_size)
+        free_ranges.emplace(offset + alloc_size, range_size - alloc_size);
+
+    allocations.emplace(offset, alloc_size);
+    if (data_size > 0)
+        glNamedBufferSubData(id, offset, data_size, data);
 
     return offset;
-};
\ No newline at end of file
+};
+
+void Buffer::free(uint32_t offset)
+{
+    auto it = allocations.find(offset);
+    if (it == allocations.end())
+    {
+        logger.error("Freeing unallocated buffer range at offset {}.", offset);
+        return;
+    }
+
+    insert_free_range(it->first, it->second);
+    allocations.erase(it);
+}
+
+vector<Buffer::Relocation> Buffer::defragment()
+{
+    vector<pair<uint32_t, uint32_t>> live(allocations.begin(),
+                                          allocations.end());
+    sort(live.begin(), live.end());
+
+    uint32_t live_size = 0;
+    for (const auto &[offset, range_size] : live)
+        live_size += range_size;
+
+    // Shrink to the live ranges, later allocations grow the buffer again.
+    const uint32_t new_capacity = max(live_size, alignment);
+
+    // Copy into a fresh buffer, copies within a single buffer can't overlap.
+    uint new_id;
+    glCreateBuffers(1, &new_id);
+    glNamedBufferStorage(new_id, new_capacity, nullptr,
+                         GL_DYNAMIC_STORAGE_BIT);
+
+    vector<Relocation> relocations;
+    allocations.clear();
+
+    uint32_t end = 0;
+    for (const auto &[offset, range_size] : live)
+    {
+        glCopyNamedBufferSubData(id, new_id, offset, end, range_size);
+        allocations.emplace(end, range_size);
+
+        if (offset != end)
+            relocations.push_back({offset, end});
+
+        end += range_size;
+    }
+
+    glDeleteBuffers(1, &id);
+
+    logger.info("Buffer {} shrunk from {} to {} bytes.", new_id, capacity,
+                new_capacity);
+
+    id = new_id;
+    capacity = new_capacity;
+
+    free_ranges.clear();
+    if (end < capacity)
+        free_ranges.emplace(end, capacity - end);
+
+    return relocations;
+}
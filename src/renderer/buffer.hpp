@@ -1,21 +1,53 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
 #include "constants.hpp"
 
 namespace engine
 {
 
+// GPU buffer sub-allocator. Free ranges are kept sorted by offset so they can
+// be coalesced with their neighbours on release.
 class Buffer
 {
     uint id;
     uint32_t capacity;
-    uint32_t size = 0;
+    uint32_t alignment;
+
+    // Offset to size.
+    std::map<uint32_t, uint32_t> free_ranges;
+    std::unordered_map<uint32_t, uint32_t> allocations;
+
+    void grow(uint32_t min_capacity);
+    void insert_free_range(uint32_t offset, uint32_t range_size);
 
   public:
+    struct Relocation
+    {
+        uint32_t old_offset;
+        uint32_t new_offset;
+    };
+
+    // Allocation sizes are rounded up to a multiple of the alignment, so
+    // offsets into a vertex buffer stay a multiple of the vertex size.
     Buffer(uint32_t capacity, uint32_t alignment);
 
     uint get_id();
-    uint32_t allocate(const void *data, uint32_t alloc_size);
+    uint32_t get_capacity() const;
+    uint32_t get_used_size() const;
+
+    // Uploads data_size bytes of data, which may be null when the size is 0.
+    uint32_t allocate(const void *data, uint32_t data_size);
+    void free(uint32_t offset);
+
+    // Move all live ranges to the front of a new buffer that fits them
+    // exactly. Previous offsets are invalidated, the returned relocations map
+    // them to their new location.
+    std::vector<Relocation> defragment();
 };
 
-} // namespace engine
\ No newline at end of file
+} // namespace engine
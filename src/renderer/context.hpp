@@ -4,8 +4,10 @@
 
 #include "constants.hpp"
 #include "entity.hpp"
+#include "math.hpp"
 #include "model.hpp"
 #include "renderer/buffer.hpp"
+#include "renderer/culling.hpp"
 #include "renderer/light.hpp"
 
 namespace engine
@@ -26,13 +28,19 @@ struct MeshInstance
     uint32_t vertex_offset = 0u;
     uint64_t index_offset_bytes = 0u;
     int primitive_count = 0;
+    // Object space.
+    Aabb bounds{};
+    // Owns its vertex and index ranges, even without primitives.
+    bool registered = false;
 };
 
 struct ViewportContext
 {
     glm::ivec2 size{0};
+    // Resolution of the passes up to TAA, smaller than size when dynamic
+    // resolution is active.
+    glm::ivec2 render_size{0};
     uint hdr_tex = invalid_texture_id;
-    uint hdr2_tex = invalid_texture_id;
     uint id_tex = invalid_texture_id;
     uint history_tex = invalid_texture_id;
     uint hdr_frame_buf = default_frame_buffer_id;
@@ -53,6 +61,10 @@ struct ViewportContext
     uint reflections_tex = invalid_texture_id;
     std::span<float> cascade_distances{};
     std::span<glm::mat4> light_transforms{};
+    // Froxel light lists, see LightCullingPass.
+    uint light_cluster_uniforms = 0;
+    uint light_clusters = 0;
+    uint light_cluster_indices = 0;
 };
 
 struct RenderContext
@@ -60,8 +72,15 @@ struct RenderContext
     DirectionalLight sun{};
     std::vector<MeshInstance> mesh_instances{};
     std::vector<Entity> queue{};
+    // World space bounds of the queue, in the same order.
+    BoundsSoa queue_bounds{};
     std::vector<Light> lights{};
-    uint light_shadows_array = invalid_texture_id;
+    // Shadow maps of all point lights, six square tiles per light. The rect
+    // buffer holds the offset and size of each tile in texture coordinates.
+    uint light_shadow_atlas = invalid_texture_id;
+    uint light_shadow_rects = 0;
+    // Point lights packed for shaders, rebuilt every frame.
+    uint light_buf = 0;
     uint entity_vao = invalid_texture_id;
     uint skybox_vao = invalid_texture_id;
     uint skybox_tex = invalid_texture_id;
@@ -71,6 +90,16 @@ struct RenderContext
     std::vector<glm::vec3> probes{};
     size_t sphere_mesh_idx = -1;
     float dt = 0.f;
+    // Submit scene geometry with glMultiDrawElementsIndirect instead of one
+    // draw call per entity.
+    bool indirect_draws = true;
+    // Frustum and occlusion culling of the geometry pass on the GPU.
+    bool gpu_culling = true;
+    // Frustum culling of the queue on the CPU, before draw lists are built.
+    bool cpu_culling = true;
+    // Shade point lights from per-froxel light lists instead of drawing a
+    // sphere per light.
+    bool clustered_lights = true;
     Buffer vertex_buf;
     Buffer index_buf;
 };
@@ -0,0 +1,159 @@
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <Tracy.hpp>
+
+#include "culling.hpp"
+
+using namespace std;
+using namespace glm;
+using namespace engine;
+
+size_t BoundsSoa::size() const { return min_x.size(); }
+
+void BoundsSoa::clear()
+{
+    min_x.clear();
+    min_y.clear();
+    min_z.clear();
+    max_x.clear();
+    max_y.clear();
+    max_z.clear();
+}
+
+void BoundsSoa::push_back(const Aabb &aabb)
+{
+    min_x.push_back(aabb.min.x);
+    min_y.push_back(aabb.min.y);
+    min_z.push_back(aabb.min.z);
+    max_x.push_back(aabb.max.x);
+    max_y.push_back(aabb.max.y);
+    max_z.push_back(aabb.max.z);
+}
+
+Frustum engine::make_frustum(const mat4 &view_proj)
+{
+    const mat4 m = transpose(view_proj);
+
+    Frustum f{{
+        m[3] + m[0], // Left
+        m[3] - m[0], // Right
+        m[3] + m[1], // Bottom
+        m[3] - m[1], // Top
+        m[3] + m[2], // Near
+        m[3] - m[2], // Far
+    }};
+
+    for (auto &p : f.planes)
+        p /= length(vec3(p));
+
+    return f;
+}
+
+// For every plane only the box corner furthest along the normal has to be
+// tested. The normal is the same for all boxes, so the corner can be picked
+// per plane instead of per box.
+void engine::cull_frustum(const BoundsSoa &bounds, const Frustum &frustum,
+                          span<uint32_t> masks, uint32_t bit)
+{
+    ZoneScoped;
+
+    const size_t count = bounds.size();
+
+    array<const float *, 6> xs, ys, zs;
+    for (size_t p = 0; p < 6; p++)
+    {
+        const vec4 &plane = frustum.planes[p];
+        xs[p] = plane.x > 0.f ? bounds.max_x.data() : bounds.min_x.data();
+        ys[p] = plane.y > 0.f ? bounds.max_y.data() : bounds.min_y.data();
+        zs[p] = plane.z > 0.f ? bounds.max_z.data() : bounds.min_z.data();
+    }
+
+    size_t i = 0;
+
+#if defined(__AVX__)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 outside = _mm256_setzero_ps();
+
+        for (size_t p = 0; p < 6; p++)
+        {
+            const vec4 &plane = frustum.planes[p];
+
+            __m256 d = _mm256_set1_ps(plane.w);
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.x),
+                                               _mm256_loadu_ps(xs[p] + i)));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.y),
+                                               _mm256_loadu_ps(ys[p] + i)));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(plane.z),
+                                               _mm256_loadu_ps(zs[p] + i)));
+
+            outside = _mm256_or_ps(
+                outside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+
+        const int outside_bits = _mm256_movemask_ps(outside);
+        for (size_t j = 0; j < 8; j++)
+            if ((outside_bits & (1 << j)) == 0)
+                masks[i + j] |= bit;
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 outside = _mm_setzero_ps();
+
+        for (size_t p = 0; p < 6; p++)
+        {
+            const vec4 &plane = frustum.planes[p];
+
+            __m128 d = _mm_set1_ps(plane.w);
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.x),
+                                         _mm_loadu_ps(xs[p] + i)));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.y),
+                                         _mm_loadu_ps(ys[p] + i)));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane.z),
+                                         _mm_loadu_ps(zs[p] + i)));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+        }
+
+        const int outside_bits = _mm_movemask_ps(outside);
+        for (size_t j = 0; j < 4; j++)
+            if ((outside_bits & (1 << j)) == 0)
+                masks[i + j] |= bit;
+    }
+#endif
+
+    // Remainder, or everything without SIMD support.
+    for (; i < count; i++)
+    {
+        bool outside = false;
+
+        for (size_t p = 0; p < 6; p++)
+        {
+            const vec4 &plane = frustum.planes[p];
+            outside |= plane.x * xs[p][i] + plane.y * ys[p][i] +
+                           plane.z * zs[p][i] + plane.w <
+                       0.f;
+        }
+
+        if (!outside)
+            masks[i] |= bit;
+    }
+}
+
+void engine::cull_queue(const vector<Entity> &queue, const BoundsSoa &bounds,
+                        const Frustum &frustum, vector<uint32_t> &masks,
+                        vector<Entity> &visible)
+{
+    masks.assign(queue.size(), 0u);
+    cull_frustum(bounds, frustum, masks, 1u);
+
+    visible.clear();
+    for (size_t i = 0; i < queue.size(); i++)
+        if (masks[i] != 0)
+            visible.push_back(queue[i]);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "entity.hpp"
+#include "math.hpp"
+
+namespace engine
+{
+
+// Axis-aligned boxes in structure-of-arrays layout, so the frustum test can
+// process several boxes per instruction.
+struct BoundsSoa
+{
+    std::vector<float> min_x, min_y, min_z;
+    std::vector<float> max_x, max_y, max_z;
+
+    size_t size() const;
+    void clear();
+    void push_back(const Aabb &aabb);
+};
+
+struct Frustum
+{
+    // Normals point inwards, w holds the plane distance.
+    std::array<glm::vec4, 6> planes;
+};
+
+// Extracts the clip planes of a (view) projection matrix, see "Fast
+// Extraction of Viewing Frustum Planes from the World-View-Projection
+// Matrix" by Gribb and Hartmann.
+Frustum make_frustum(const glm::mat4 &view_proj);
+
+// Sets bit in masks[i] for every box that intersects the frustum. Boxes that
+// straddle a plane count as visible.
+void cull_frustum(const BoundsSoa &bounds, const Frustum &frustum,
+                  std::span<uint32_t> masks, uint32_t bit);
+
+// Replaces visible with the entities of queue that intersect the frustum.
+void cull_queue(const std::vector<Entity> &queue, const BoundsSoa &bounds,
+                const Frustum &frustum, std::vector<uint32_t> &masks,
+                std::vector<Entity> &visible);
+
+} // namespace engine
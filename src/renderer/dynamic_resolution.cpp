@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <cmath>
+
+#include "renderer/dynamic_resolution.hpp"
+
+using namespace engine;
+using namespace glm;
+
+DynamicResolution::DynamicResolution(Params params) : params(params) {}
+
+ivec2 DynamicResolution::update(ivec2 size, float gpu_time_ms)
+{
+    const float max_scale = 1.f;
+
+    if (!enabled)
+    {
+        scale = max_scale;
+        cooldown = 0;
+    }
+    else if (cooldown > 0)
+    {
+        cooldown--;
+    }
+    else if (gpu_time_ms > 0.f)
+    {
+        const float ratio = params.target_ms / gpu_time_ms;
+
+        float desired = scale;
+
+        // Cost is roughly proportional to the pixel count, so the square
+        // root of the ratio gives the scale that would hit the target. Drop
+        // to it at once, but only grow a step at a time to avoid
+        // overshooting back into an expensive frame.
+        if (ratio < 1.f - params.tolerance)
+            desired = scale * std::sqrt(ratio);
+        else if (ratio > 1.f + params.tolerance)
+            desired = scale + params.step;
+
+        desired = std::round(desired / params.step) * params.step;
+        desired = std::clamp(desired, params.min_scale, max_scale);
+
+        if (desired != scale)
+        {
+            scale = desired;
+            cooldown = sample_count;
+        }
+    }
+
+    return max(ivec2(round(vec2(size) * scale)), ivec2(1));
+}
+
+float DynamicResolution::get_scale() const { return scale; }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace engine
+{
+
+// Scales the internal render resolution to keep the GPU frame time near a
+// target. Everything up to TAA renders at the scaled size, TAA reconstructs
+// the output resolution from the jittered samples.
+class DynamicResolution
+{
+    float scale = 1.f;
+    int cooldown = 0;
+
+  public:
+    // Frames averaged per measurement, and waited for after a change so the
+    // average only covers frames at the new scale.
+    static constexpr int sample_count = 15;
+
+    struct Params
+    {
+        float target_ms;
+        float min_scale;
+        // Scales are snapped to multiples of this, which bounds the number of
+        // render target sizes cycling through the texture pool.
+        float step;
+        // Relative deviation from the target that is tolerated.
+        float tolerance;
+    };
+
+    bool enabled = false;
+    Params params;
+
+    DynamicResolution(Params params);
+
+    // Returns the render size for this frame, given the output size and the
+    // average GPU frame time in milliseconds.
+    glm::ivec2 update(glm::ivec2 size, float gpu_time_ms);
+
+    float get_scale() const;
+};
+
+} // namespace engine
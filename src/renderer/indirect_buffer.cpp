@@ -0,0 +1,97 @@
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "indirect_buffer.hpp"
+#include "profiler.hpp"
+
+using namespace std;
+using namespace engine;
+
+IndirectBuffer::IndirectBuffer(uint32_t capacity) { reserve(capacity); }
+
+uint IndirectBuffer::get_id() const { return id; }
+
+void IndirectBuffer::reserve(uint32_t count)
+{
+    if (count <= capacity)
+        return;
+
+    capacity = max(count, 2 * capacity);
+
+    glDeleteBuffers(1, &id);
+    glCreateBuffers(1, &id);
+    glNamedBufferStorage(id, capacity * sizeof(DrawCommand), nullptr,
+                         GL_DYNAMIC_STORAGE_BIT);
+}
+
+void IndirectBuffer::clear() { commands.clear(); }
+
+void IndirectBuffer::push(const MeshInstance &mesh, uint32_t base_instance)
+{
+    commands.push_back(DrawCommand{
+        .count = static_cast<uint32_t>(mesh.primitive_count),
+        .instance_count = 1,
+        .first_index =
+            static_cast<uint32_t>(mesh.index_offset_bytes / sizeof(uint32_t)),
+        .base_vertex = static_cast<int32_t>(mesh.vertex_offset),
+        .base_instance = base_instance,
+    });
+}
+
+void IndirectBuffer::upload()
+{
+    if (commands.empty())
+        return;
+
+    reserve(static_cast<uint32_t>(commands.size()));
+    glNamedBufferSubData(id, 0, commands.size() * sizeof(DrawCommand),
+                         commands.data());
+}
+
+void IndirectBuffer::draw(bool indirect) const
+{
+    draw(0, commands.size(), indirect);
+}
+
+void IndirectBuffer::draw(size_t first, size_t count, bool indirect) const
+{
+    if (count == 0)
+        return;
+
+    const uint64_t triangles = triangle_count(first, count);
+
+    if (!indirect)
+    {
+        for (size_t i = first; i < first + count; i++)
+        {
+            const auto &c = commands[i];
+            glDrawElementsInstancedBaseVertexBaseInstance(
+                GL_TRIANGLES, c.count, GL_UNSIGNED_INT,
+                reinterpret_cast<const void *>(c.first_index *
+                                               sizeof(uint32_t)),
+                c.instance_count, c.base_vertex, c.base_instance);
+        }
+
+        profiler_count_draws(static_cast<uint32_t>(count), triangles);
+        return;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, id);
+    glMultiDrawElementsIndirect(
+        GL_TRIANGLES, GL_UNSIGNED_INT,
+        reinterpret_cast<const void *>(first * sizeof(DrawCommand)),
+        static_cast<GLsizei>(count), 0);
+    profiler_count_draws(1, triangles);
+}
+
+uint64_t IndirectBuffer::triangle_count(size_t first, size_t count) const
+{
+    uint64_t triangles = 0;
+
+    for (size_t i = first; i < first + count; i++)
+        triangles += static_cast<uint64_t>(commands[i].instance_count) *
+                     (commands[i].count / 3);
+
+    return triangles;
+}
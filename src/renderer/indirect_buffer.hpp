@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "constants.hpp"
+#include "renderer/context.hpp"
+
+namespace engine
+{
+
+// Layout of DrawElementsIndirectCommand as consumed by
+// glMultiDrawElementsIndirect.
+struct DrawCommand
+{
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+};
+
+// Commands are recorded on the CPU and uploaded in one go before drawing.
+// Draws read the entity vertex and index buffers through the entity VAO.
+class IndirectBuffer
+{
+    uint id = 0;
+    uint32_t capacity = 0;
+
+    void reserve(uint32_t count);
+
+  public:
+    std::vector<DrawCommand> commands;
+
+    IndirectBuffer(uint32_t capacity = 1024);
+
+    uint get_id() const;
+
+    void clear();
+    // The base instance is visible to shaders as gl_BaseInstance.
+    void push(const MeshInstance &mesh, uint32_t base_instance);
+    void upload();
+
+    // Submits commands with a single glMultiDrawElementsIndirect call, or
+    // one draw call per command when indirect is false.
+    void draw(bool indirect = true) const;
+    void draw(size_t first, size_t count, bool indirect = true) const;
+
+    uint64_t triangle_count(size_t first, size_t count) const;
+};
+
+} // namespace engine
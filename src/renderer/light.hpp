@@ -22,4 +22,13 @@ struct Light
     float radius_squared(float eps) const;
 };
 
+// Mirrors PointLightData in uniforms.h.
+struct PointLightData
+{
+    glm::vec3 position{0.f};
+    float radius = 0.f;
+    glm::vec3 color{0.f};
+    float radius_squared = 0.f;
+};
+
 } // namespace engine
\ No newline at end of file
@@ -16,29 +16,38 @@ BloomPass::BloomPass(BloomConfig cfg) : cfg(cfg)
     upsample = *Shader::from_comp_path(shaders_path / "bloom_upsample.comp");
 }
 
+TextureDesc BloomPass::downsample_desc(glm::ivec2 size) const
+{
+    return {
+        .size = size / 2,
+        .format = GL_RGBA16F,
+        .levels = static_cast<int>(cfg.pass_count),
+        .min_filter = GL_LINEAR,
+        .mag_filter = GL_LINEAR,
+    };
+}
+
+TextureDesc BloomPass::upsample_desc(glm::ivec2 size) const
+{
+    return {
+        .size = size / 2,
+        .format = GL_RGBA16F,
+        .levels = static_cast<int>(cfg.pass_count) - 1,
+        .min_filter = GL_NEAREST_MIPMAP_LINEAR,
+        .mag_filter = GL_LINEAR,
+    };
+}
+
 void BloomPass::initialize(ViewportContext &ctx)
 {
-    glDeleteTextures(2, &downsample_tex);
-    glCreateTextures(GL_TEXTURE_2D, 2, &downsample_tex);
-
-    glTextureStorage2D(downsample_tex, cfg.pass_count, GL_RGBA16F,
-                       ctx.size.x / 2, ctx.size.y / 2);
-    glTextureParameteri(downsample_tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTextureParameteri(downsample_tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTextureParameteri(downsample_tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(downsample_tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glTextureStorage2D(upsample_tex, cfg.pass_count - 1, GL_RGBA16F,
-                       ctx.size.x / 2, ctx.size.y / 2);
-    glTextureParameteri(upsample_tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTextureParameteri(upsample_tex, GL_TEXTURE_MIN_FILTER,
-                        GL_NEAREST_MIPMAP_LINEAR);
-    glTextureParameteri(upsample_tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(upsample_tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    downsample_level = downsample_hq.uniform("u_level");
+    upsample_level = upsample.uniform("u_level");
+    upsample_target_level = upsample.uniform("u_target_level");
 }
 
 void BloomPass::render(ViewportContext &ctx_v, RenderContext &r_ctx,
-                       uint source, uint target)
+                       uint source, uint target, uint downsample_tex,
+                       uint upsample_tex)
 {
     ZoneScoped;
 
@@ -48,7 +57,7 @@ void BloomPass::render(ViewportContext &ctx_v, RenderContext &r_ctx,
 
     glUseProgram(downsample_shader.get_id());
 
-    glBindTextureUnit(0u, ctx_v.hdr2_tex);
+    glBindTextureUnit(0u, source);
 
     for (uint i = 0u; i < cfg.pass_count; i++)
     {
@@ -56,7 +65,7 @@ void BloomPass::render(ViewportContext &ctx_v, RenderContext &r_ctx,
         const uint group_count_x = ((ctx_v.size.x >> (i + 1u)) + 15u) / 16u;
         const uint group_count_y = ((ctx_v.size.y >> (i + 1u)) + 15u) / 16u;
 
-        downsample_shader.set("u_level", i);
+        downsample_shader.set(downsample_level, i);
 
         glBindImageTexture(1u, downsample_tex, i, false, 0, GL_WRITE_ONLY,
                            GL_RGBA16F);
@@ -81,8 +90,8 @@ void BloomPass::render(ViewportContext &ctx_v, RenderContext &r_ctx,
         const uint group_count_x = ((ctx_v.size.x >> (i + 1u)) + 15u) / 16u;
         const uint group_count_y = ((ctx_v.size.y >> (i + 1u)) + 15u) / 16u;
 
-        upsample.set("u_level", (uint)i + 1u);
-        upsample.set("u_target_level", (uint)i);
+        upsample.set(upsample_level, (uint)i + 1u);
+        upsample.set(upsample_target_level, (uint)i);
 
         glBindImageTexture(2u, upsample_tex, i, false, 0, GL_WRITE_ONLY,
                            GL_RGBA16F);
@@ -94,8 +103,9 @@ void BloomPass::render(ViewportContext &ctx_v, RenderContext &r_ctx,
             glBindTextureUnit(0u, upsample_tex);
     }
 
-    uint group_count_x = ctx_v.size.x / 16u;
-    uint group_count_y = ctx_v.size.y / 16u;
+    // Round up, the target is transient and has no valid pixels to keep.
+    uint group_count_x = (ctx_v.size.x + 15u) / 16u;
+    uint group_count_y = (ctx_v.size.y + 15u) / 16u;
 
     upsample.set("u_level", 0u);
     upsample.set("u_target_level", 0u);
@@ -105,6 +115,4 @@ void BloomPass::render(ViewportContext &ctx_v, RenderContext &r_ctx,
     glBindImageTexture(2u, target, 0, false, 0, GL_READ_WRITE, GL_RGBA16F);
 
     glDispatchCompute(group_count_x, group_count_y, 1u);
-    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
-                    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "constants.hpp"
 #include "renderer/pass.hpp"
+#include "renderer/render_graph.hpp"
 #include "shader.hpp"
 
 namespace engine
@@ -16,13 +17,15 @@ struct BloomConfig
 
 class BloomPass
 {
-    uint downsample_tex = invalid_texture_id;
-    uint upsample_tex = invalid_texture_id;
-
     Shader downsample;
     Shader downsample_hq;
     Shader upsample;
 
+    // Set once per mip level.
+    UniformHandle downsample_level;
+    UniformHandle upsample_level;
+    UniformHandle upsample_target_level;
+
   public:
     bool enabled = true;
 
@@ -30,9 +33,13 @@ class BloomPass
 
     BloomPass(BloomConfig cfg);
 
+    // Mip chains at half the viewport size, transient to the pass.
+    TextureDesc downsample_desc(glm::ivec2 size) const;
+    TextureDesc upsample_desc(glm::ivec2 size) const;
+
     void initialize(ViewportContext &ctx);
     void render(ViewportContext &ctx_v, RenderContext &r_ctx, uint source,
-                uint target);
+                uint target, uint downsample_tex, uint upsample_tex);
 };
 
 } // namespace engine
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <Tracy.hpp>
 
 #include "forward.hpp"
+#include "profiler.hpp"
 #include "renderer/renderer.hpp"
 
 using namespace std;
@@ -18,7 +19,12 @@ ForwardPass::ForwardPass(ForwardConfig cfg) : draw_probes(cfg.draw_probes)
         .vert = shaders_path / "skybox.vs",
         .frag = shaders_path / "skybox.fs",
     });
+}
+
+void ForwardPass::parse_parameters() {}
 
+void ForwardPass::initialize(ViewportContext &ctx)
+{
     probe_shader.set("u_sh_0", 0);
     probe_shader.set("u_sh_1", 1);
     probe_shader.set("u_sh_2", 2);
@@ -26,21 +32,22 @@ ForwardPass::ForwardPass(ForwardConfig cfg) : draw_probes(cfg.draw_probes)
     probe_shader.set("u_sh_4", 4);
     probe_shader.set("u_sh_5", 5);
     probe_shader.set("u_sh_6", 6);
-}
 
-void ForwardPass::parse_parameters() {}
-
-void ForwardPass::initialize(ViewportContext &ctx) {}
+    probe_model = probe_shader.uniform("u_model");
+    probe_mvp = probe_shader.uniform("u_mvp");
+}
 
 void ForwardPass::render(ViewportContext &ctx_v, RenderContext &ctx_r)
 {
     ZoneScoped;
 
-    glViewport(0, 0, ctx_v.size.x, ctx_v.size.y);
+    const ivec2 size = ctx_v.render_size;
+
+    glViewport(0, 0, size.x, size.y);
     glBindFramebuffer(GL_FRAMEBUFFER, ctx_v.hdr_frame_buf);
     glBlitNamedFramebuffer(ctx_v.g_buf.framebuffer, ctx_v.hdr_frame_buf, 0, 0,
-                           ctx_v.size.x, ctx_v.size.y, 0, 0, ctx_v.size.x,
-                           ctx_v.size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+                           size.x, size.y, 0, 0, size.x, size.y,
+                           GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 
     glBindVertexArray(ctx_r.skybox_vao);
 
@@ -52,6 +59,7 @@ void ForwardPass::render(ViewportContext &ctx_v, RenderContext &ctx_r)
     glBindTextureUnit(0, ctx_r.skybox_tex);
 
     glDrawArrays(GL_TRIANGLES, 0, 36);
+    profiler_count_draws(1, 12);
 
     if (draw_probes)
     {
@@ -75,8 +83,8 @@ void ForwardPass::render(ViewportContext &ctx_v, RenderContext &ctx_r)
             const mat4 model =
                 scale(translate(mat4(1.f), position), vec3(0.2f));
 
-            probe_shader.set("u_model", model);
-            probe_shader.set("u_mvp", ctx_v.proj * ctx_v.view * model);
+            probe_shader.set(probe_model, model);
+            probe_shader.set(probe_mvp, ctx_v.proj * ctx_v.view * model);
 
             Renderer::render_mesh_instance(
                 ctx_r.mesh_instances[ctx_r.sphere_mesh_idx]);
@@ -15,6 +15,8 @@ class ForwardPass
 {
     Shader skybox_shader;
     Shader probe_shader;
+    UniformHandle probe_model;
+    UniformHandle probe_mvp;
 
   public:
     bool draw_probes;
@@ -1,11 +1,19 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+
 #include <Tracy.hpp>
 #include <glm/ext.hpp>
 #include <glm/glm.hpp>
 
 #include "geometry.hpp"
 #include "logger.hpp"
+#include "math.hpp"
 #include "model.hpp"
+#include "profiler.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/texture_pool.hpp"
 
 using namespace std;
 using namespace glm;
@@ -17,6 +25,13 @@ void GeometryPass::create_debug_views()
     array<int, 4> rg_swizzle{GL_RED, GL_GREEN, GL_ZERO, GL_ONE};
     array<int, 4> www_swizzle{GL_ALPHA, GL_ALPHA, GL_ALPHA, GL_ONE};
 
+    // Views keep the storage they were made from alive.
+    glDeleteTextures(1, &debug_view_normal);
+    glDeleteTextures(1, &debug_view_metallic);
+    glDeleteTextures(1, &debug_view_base_color);
+    glDeleteTextures(1, &debug_view_roughness);
+    glDeleteTextures(1, &debug_view_velocity);
+
     glGenTextures(1, &debug_view_normal);
     glTextureView(debug_view_normal, GL_TEXTURE_2D, normal_metal, GL_RGBA16F, 0,
                   1, 0, 1);
@@ -63,31 +78,85 @@ GeometryPass::GeometryPass()
     glNamedFramebufferDrawBuffer(fbuf_downsample, GL_NONE);
     glNamedFramebufferReadBuffer(fbuf_downsample, GL_NONE);
 
-    downsample_shader.set("u_read", 3);
+    reserve_draws(1024);
 }
 
-void GeometryPass::initialize(ViewportContext &ctx)
+void GeometryPass::reserve_draws(uint32_t count)
 {
-    glDeleteTextures(4, &normal_metal);
-    glCreateTextures(GL_TEXTURE_2D, 4, &normal_metal);
+    if (count <= draw_capacity)
+        return;
 
-    glDeleteTextures(1, &ctx.id_tex);
-    glCreateTextures(GL_TEXTURE_2D, 1, &ctx.id_tex);
+    // The old buffer may still be read by frames in flight.
+    for (auto &fence : draw_fences)
+    {
+        if (fence == nullptr)
+            continue;
 
-    glTextureStorage2D(normal_metal, 1, GL_RGBA16F, ctx.size.x, ctx.size.y);
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
 
-    glTextureStorage2D(base_color_rough, 1, GL_SRGB8_ALPHA8, ctx.size.x,
-                       ctx.size.y);
+    if (draw_buf != 0)
+    {
+        glUnmapNamedBuffer(draw_buf);
+        glDeleteBuffers(1, &draw_buf);
+    }
+
+    // Keep region offsets aligned for glBindBufferRange, the required
+    // alignment is at most 256 bytes.
+    draw_capacity = (std::max(count, 2 * draw_capacity) + 63) / 64 * 64;
+
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = frames_in_flight * draw_capacity * sizeof(DrawData);
 
-    glTextureStorage2D(velocity, 1, GL_RGBA16F, ctx.size.x, ctx.size.y);
+    glCreateBuffers(1, &draw_buf);
+    glNamedBufferStorage(draw_buf, size, nullptr, flags);
+    draw_buf_ptr = static_cast<DrawData *>(
+        glMapNamedBufferRange(draw_buf, 0, size, flags));
+}
 
-    glTextureStorage2D(depth, 2, GL_DEPTH_COMPONENT32, ctx.size.x, ctx.size.y);
-    glTextureParameteri(depth, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(depth, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(depth, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTextureParameteri(depth, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+void GeometryPass::initialize(ViewportContext &ctx)
+{
+    // Programs are resolved by now, see Shader::resolve_pending.
+    downsample_shader.set("u_read", 3);
 
-    glTextureStorage2D(ctx.id_tex, 1, GL_R32UI, ctx.size.x, ctx.size.y);
+    shader.set("u_base_color", 0);
+    shader.set("u_normal", 1);
+    shader.set("u_metallic_roughness", 2);
+
+    hiz_copy_depth = hiz_shader.uniform("u_copy_depth");
+
+    for (const uint tex : {normal_metal, base_color_rough, velocity, depth,
+                           ctx.id_tex, hiz})
+        texture_pool.release(tex);
+
+    normal_metal = texture_pool.acquire({
+        .size = ctx.render_size,
+        .format = GL_RGBA16F,
+    });
+    base_color_rough = texture_pool.acquire({
+        .size = ctx.render_size,
+        .format = GL_SRGB8_ALPHA8,
+    });
+    velocity = texture_pool.acquire({
+        .size = ctx.render_size,
+        .format = GL_RGBA16F,
+    });
+    depth = texture_pool.acquire({
+        .size = ctx.render_size,
+        .format = GL_DEPTH_COMPONENT32,
+        .levels = 2,
+        .min_filter = GL_NEAREST,
+        .mag_filter = GL_NEAREST,
+    });
+    ctx.id_tex = texture_pool.acquire({
+        .size = ctx.render_size,
+        .format = GL_R32UI,
+        .min_filter = GL_NEAREST,
+        .mag_filter = GL_NEAREST,
+    });
 
     glNamedFramebufferTexture(fbuf, GL_DEPTH_ATTACHMENT, depth, 0);
     glNamedFramebufferTexture(fbuf, GL_COLOR_ATTACHMENT0, normal_metal, 0);
@@ -99,8 +168,8 @@ void GeometryPass::initialize(ViewportContext &ctx)
         GL_FRAMEBUFFER_COMPLETE)
         logger.error("G-buffer incomplete");
 
-    ctx.g_buf = GBuffer{ctx.size,     fbuf,     base_color_rough,
-                        normal_metal, velocity, depth};
+    ctx.g_buf = GBuffer{ctx.render_size, fbuf,     base_color_rough,
+                        normal_metal,    velocity, depth};
 
     create_debug_views();
 
@@ -110,6 +179,177 @@ void GeometryPass::initialize(ViewportContext &ctx)
     if (glCheckNamedFramebufferStatus(fbuf_downsample, GL_FRAMEBUFFER) !=
         GL_FRAMEBUFFER_COMPLETE)
         logger.error("Downsample framebuffer incomplete");
+
+    hiz_size = ctx.render_size;
+    hiz_level_count = 1 + static_cast<int>(floor(
+                              log2(std::max(hiz_size.x, hiz_size.y))));
+    hiz_valid = false;
+
+    hiz = texture_pool.acquire({
+        .size = ctx.render_size,
+        .format = GL_R32F,
+        .levels = hiz_level_count,
+        .min_filter = GL_NEAREST_MIPMAP_NEAREST,
+        .mag_filter = GL_NEAREST,
+    });
+}
+
+// Recreates the buffer when it's too small, and uploads data when given.
+static void upload_storage(uint &buf, size_t &capacity, const void *data,
+                           size_t size)
+{
+    if (size > capacity)
+    {
+        capacity = std::max(size, 2 * capacity);
+
+        glDeleteBuffers(1, &buf);
+        glCreateBuffers(1, &buf);
+        glNamedBufferStorage(buf, capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    if (data != nullptr && size > 0)
+        glNamedBufferSubData(buf, 0, size, data);
+}
+
+void GeometryPass::cull_draws(const RenderArgs &args)
+{
+    ZoneScoped;
+
+    const auto &commands = entity_draws.commands;
+
+    cull_bounds.resize(2 * args.entities.size());
+    for (size_t i = 0; i < args.entities.size(); i++)
+    {
+        const auto &r = args.entities[i];
+        const Aabb aabb =
+            transform_aabb(args.meshes[r.mesh_index].bounds, r.model);
+
+        cull_bounds[2 * i] = vec4(aabb.min, 1.f);
+        cull_bounds[2 * i + 1] = vec4(aabb.max, 1.f);
+    }
+
+    command_batches.resize(commands.size());
+    batch_offsets.resize(batches.size());
+    for (uint32_t b = 0; b < batches.size(); b++)
+    {
+        batch_offsets[b] = static_cast<uint32_t>(batches[b].first);
+        fill_n(command_batches.begin() + batches[b].first, batches[b].count,
+               b);
+    }
+
+    upload_storage(bounds_buf, cull_buf_sizes[0], cull_bounds.data(),
+                   cull_bounds.size() * sizeof(vec4));
+    upload_storage(command_batches_buf, cull_buf_sizes[1],
+                   command_batches.data(),
+                   command_batches.size() * sizeof(uint32_t));
+    upload_storage(batch_offsets_buf, cull_buf_sizes[2], batch_offsets.data(),
+                   batch_offsets.size() * sizeof(uint32_t));
+    upload_storage(visible_draws_buf, cull_buf_sizes[3], nullptr,
+                   commands.size() * sizeof(DrawCommand));
+    upload_storage(batch_counts_buf, cull_buf_sizes[4], nullptr,
+                   batches.size() * sizeof(uint32_t));
+
+    glClearNamedBufferSubData(batch_counts_buf, GL_R32UI, 0,
+                              batches.size() * sizeof(uint32_t), GL_RED_INTEGER,
+                              GL_UNSIGNED_INT, nullptr);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, entity_draws.get_id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bounds_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, command_batches_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, batch_offsets_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, visible_draws_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, batch_counts_buf);
+    glBindTextureUnit(0, hiz);
+
+    cull_shader.set("u_command_count", static_cast<uint>(commands.size()));
+    cull_shader.set("u_view_proj", args.view_proj);
+    cull_shader.set("u_view_proj_prev", hiz_view_proj);
+    cull_shader.set("u_occlusion", hiz_valid);
+    cull_shader.set("u_hiz_level_count", hiz_level_count);
+
+    glUseProgram(cull_shader.get_id());
+    glDispatchCompute((commands.size() + cull_group_size - 1) / cull_group_size,
+                      1, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GeometryPass::build_hiz()
+{
+    ZoneScoped;
+
+    glUseProgram(hiz_shader.get_id());
+
+    ivec2 level_size = hiz_size;
+
+    for (int level = 0; level < hiz_level_count; level++)
+    {
+        hiz_shader.set(hiz_copy_depth, level == 0);
+
+        if (level == 0)
+            glBindTextureUnit(0, depth);
+        else
+            glBindImageTexture(0, hiz, level - 1, false, 0, GL_READ_ONLY,
+                               GL_R32F);
+
+        glBindImageTexture(1, hiz, level, false, 0, GL_WRITE_ONLY, GL_R32F);
+
+        const ivec2 group_count =
+            (level_size + hiz_group_size - 1) / hiz_group_size;
+        glDispatchCompute(group_count.x, group_count.y, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        level_size = max(level_size / 2, ivec2(1));
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+// Without bindless textures, draws can only be merged when they sample the
+// same textures. Sort by texture set and emit one batch per distinct set.
+void GeometryPass::build_batches(const RenderArgs &args)
+{
+    ZoneScoped;
+
+    const auto textures = [&args](uint32_t idx)
+    {
+        const auto &m = args.entities[idx].material;
+        return tuple(m.base_color, m.normal, m.metallic_roughness);
+    };
+
+    draw_order.resize(args.entities.size());
+    iota(draw_order.begin(), draw_order.end(), 0u);
+    sort(draw_order.begin(), draw_order.end(),
+         [&textures](uint32_t a, uint32_t b)
+         { return textures(a) < textures(b); });
+
+    entity_draws.clear();
+    batches.clear();
+
+    for (uint32_t idx : draw_order)
+    {
+        const auto &r = args.entities[idx];
+
+        if (batches.empty() ||
+            textures(idx) != tuple(batches.back().base_color,
+                                   batches.back().normal,
+                                   batches.back().metallic_roughness))
+        {
+            batches.push_back(Batch{
+                .base_color = r.material.base_color,
+                .normal = r.material.normal,
+                .metallic_roughness = r.material.metallic_roughness,
+                .first = entity_draws.commands.size(),
+                .count = 0,
+            });
+        }
+
+        // The base instance indexes the draw data written for the entity.
+        entity_draws.push(args.meshes[r.mesh_index], idx);
+        batches.back().count++;
+    }
+
+    entity_draws.upload();
 }
 
 void GeometryPass::render(const RenderArgs &args)
@@ -131,76 +371,112 @@ void GeometryPass::render(const RenderArgs &args)
 
     glUseProgram(shader.get_id());
 
-    for (auto &r : args.entities)
-    {
-        const auto model_view = args.view * r.model;
-        const auto mvp = args.view_proj * r.model;
-        const auto mvp_prev = args.view_proj_prev * r.model;
+    reserve_draws(static_cast<uint32_t>(args.entities.size()));
 
-        shader.set("u_mvp", mvp);
-        shader.set("u_mvp_prev", mvp_prev);
-        shader.set("u_normal_mat", inverseTranspose(mat3{model_view}));
+    draw_region = (draw_region + 1) % frames_in_flight;
+    if (auto &fence = draw_fences[draw_region]; fence != nullptr)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
 
-        shader.set("u_base_color_factor", vec3(r.material.base_color_factor));
-        shader.set("u_metallic_factor", r.material.metallic_factor);
-        shader.set("u_roughness_factor", r.material.roughness_factor);
-        shader.set("u_alpha_mask", r.material.alpha_mode == AlphaMode::mask);
-        shader.set("u_alpha_cutoff", r.material.alpha_cutoff);
+    const uint32_t region_offset = draw_region * draw_capacity;
 
-        shader.set("u_jitter", args.jitter);
-        shader.set("u_jitter_prev", args.jitter_prev);
+    {
+        ZoneScopedN("Write draw data");
 
-        if (r.material.base_color != invalid_texture_id)
-        {
-            shader.set("u_use_sampler", true);
-            shader.set("u_base_color", 0);
-            glBindTextureUnit(0, r.material.base_color);
-        }
-        else
+        for (uint32_t i = 0; i < args.entities.size(); i++)
         {
-            shader.set("u_use_sampler", false);
+            const auto &r = args.entities[i];
+            const auto model_view = args.view * r.model;
+
+            uint flags = 0;
+            if (r.material.alpha_mode == AlphaMode::mask)
+                flags |= alpha_mask;
+            if (r.material.base_color != invalid_texture_id)
+                flags |= use_base_color;
+            if (r.material.normal != invalid_texture_id)
+                flags |= use_normal;
+            if (r.material.metallic_roughness != invalid_texture_id)
+                flags |= use_metallic_roughness;
+
+            draw_buf_ptr[region_offset + i] = DrawData{
+                .mvp = args.view_proj * r.model,
+                .mvp_prev = args.view_proj_prev * r.model,
+                .normal_mat = mat4(inverseTranspose(mat3{model_view})),
+                .base_color_factor = r.material.base_color_factor,
+                .metallic_factor = r.material.metallic_factor,
+                .roughness_factor = r.material.roughness_factor,
+                .alpha_cutoff = r.material.alpha_cutoff,
+                .flags = flags,
+            };
         }
+    }
 
-        if (r.material.normal != invalid_texture_id)
-        {
-            shader.set("u_use_normal", true);
-            shader.set("u_normal", 1);
-            glBindTextureUnit(1, r.material.normal);
-        }
-        else
-        {
-            shader.set("u_use_normal", false);
-        }
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, draw_buf,
+                      region_offset * sizeof(DrawData),
+                      std::max<size_t>(args.entities.size(), 1) *
+                          sizeof(DrawData));
+
+    shader.set("u_jitter", args.jitter);
+    shader.set("u_jitter_prev", args.jitter_prev);
+
+    build_batches(args);
+
+    const bool cull = args.cull && args.indirect && !batches.empty();
 
-        if (r.material.metallic_roughness != invalid_texture_id)
+    if (cull)
+    {
+        cull_draws(args);
+
+        // Culling clobbers the bindings of the geometry shader.
+        glUseProgram(shader.get_id());
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, draw_buf,
+                          region_offset * sizeof(DrawData),
+                          args.entities.size() * sizeof(DrawData));
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, visible_draws_buf);
+        glBindBuffer(GL_PARAMETER_BUFFER, batch_counts_buf);
+    }
+
+    for (size_t i = 0; i < batches.size(); i++)
+    {
+        const auto &b = batches[i];
+
+        if (b.base_color != invalid_texture_id)
+            glBindTextureUnit(0, b.base_color);
+        if (b.normal != invalid_texture_id)
+            glBindTextureUnit(1, b.normal);
+        if (b.metallic_roughness != invalid_texture_id)
+            glBindTextureUnit(2, b.metallic_roughness);
+
+        if (cull)
         {
-            shader.set("u_use_metallic_roughness", true);
-            shader.set("u_metallic_roughness", 2);
-            glBindTextureUnit(2, r.material.metallic_roughness);
+            glMultiDrawElementsIndirectCount(
+                GL_TRIANGLES, GL_UNSIGNED_INT,
+                reinterpret_cast<const void *>(b.first * sizeof(DrawCommand)),
+                static_cast<GLintptr>(i * sizeof(uint32_t)),
+                static_cast<GLsizei>(b.count), 0);
+            // Culled on the GPU, all candidates are counted.
+            profiler_count_draws(1,
+                                 entity_draws.triangle_count(b.first, b.count));
         }
         else
         {
-            shader.set("u_use_metallic_roughness", false);
+            entity_draws.draw(b.first, b.count, args.indirect);
         }
-
-        Renderer::render_mesh_instance(args.meshes[r.mesh_index]);
     }
 
+    draw_fences[draw_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
     glUseProgram(point_light_shader.get_id());
     glDepthMask(false);
 
     point_light_shader.set("u_view_proj", args.view_proj);
 
-    for (uint32_t i = 0; i < args.lights.size(); i++)
-    {
-        const auto &light = args.lights[i];
-
-        point_light_shader.set("u_light.position", light.position);
-        point_light_shader.set("u_light.radius", 0.5f);
-        point_light_shader.set("u_id", i);
-
-        Renderer::render_mesh_instance(args.sphere_mesh);
-    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, args.light_buf);
+    Renderer::render_mesh_instances(args.sphere_mesh, args.lights.size());
 
     glDepthMask(true);
 
@@ -212,5 +488,14 @@ void GeometryPass::render(const RenderArgs &args)
 
         glUseProgram(downsample_shader.get_id());
         glDrawArrays(GL_TRIANGLES, 0, 3);
+        profiler_count_draws(1, 1);
+    }
+
+    if (args.cull)
+    {
+        build_hiz();
+        hiz_view_proj = args.view_proj;
     }
+
+    hiz_valid = args.cull;
 }
\ No newline at end of file
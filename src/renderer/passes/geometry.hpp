@@ -1,9 +1,12 @@
 #pragma once
 
+#include <array>
+
 #include <fmt/format.h>
 
 #include "constants.hpp"
 #include "renderer/context.hpp"
+#include "renderer/indirect_buffer.hpp"
 #include "renderer/pass.hpp"
 
 namespace engine
@@ -27,10 +30,90 @@ class GeometryPass
         std::vector<Entity> &entities;
         std::vector<MeshInstance> &meshes;
         std::vector<Light> &lights;
+        // Packed lights, see Renderer::update_light_buffer.
+        uint light_buf = 0;
         glm::vec2 jitter{};
         glm::vec2 jitter_prev{};
+        bool indirect = true;
+        // Frustum and Hi-Z occlusion culling on the GPU. Only applies to
+        // indirect draws. The pyramid is reused in the next frame, so views
+        // must be temporally coherent.
+        bool cull = false;
+    };
+
+    // Draws sharing the same textures, submitted together.
+    struct Batch
+    {
+        uint base_color;
+        uint normal;
+        uint metallic_roughness;
+        size_t first;
+        size_t count;
     };
 
+    // Mirrors DrawData in geometry.vs, std430 layout.
+    struct DrawData
+    {
+        glm::mat4 mvp;
+        glm::mat4 mvp_prev;
+        // Only the upper 3x3 is used, a mat3 would need column padding.
+        glm::mat4 normal_mat;
+        glm::vec4 base_color_factor;
+        float metallic_factor;
+        float roughness_factor;
+        float alpha_cutoff;
+        uint flags;
+    };
+
+    enum DrawFlags : uint
+    {
+        alpha_mask = 1 << 0,
+        use_base_color = 1 << 1,
+        use_normal = 1 << 2,
+        use_metallic_roughness = 1 << 3,
+    };
+
+    // The draw buffer is persistently mapped and split into one region per
+    // frame in flight, so writing a frame never stalls on the GPU reading a
+    // previous one.
+    static constexpr uint32_t frames_in_flight = 3;
+
+    uint draw_buf = 0;
+    DrawData *draw_buf_ptr = nullptr;
+    uint32_t draw_capacity = 0;
+    uint32_t draw_region = 0;
+    std::array<GLsync, frames_in_flight> draw_fences{};
+
+    void reserve_draws(uint32_t count);
+
+    IndirectBuffer entity_draws{};
+    std::vector<uint32_t> draw_order;
+    std::vector<Batch> batches;
+
+    void build_batches(const RenderArgs &args);
+
+    // Culling inputs, see cull.comp.
+    std::vector<glm::vec4> cull_bounds;
+    std::vector<uint32_t> command_batches;
+    std::vector<uint32_t> batch_offsets;
+
+    uint bounds_buf = 0;
+    uint command_batches_buf = 0;
+    uint batch_offsets_buf = 0;
+    uint visible_draws_buf = 0;
+    uint batch_counts_buf = 0;
+    std::array<size_t, 5> cull_buf_sizes{};
+
+    // Farthest depth pyramid of the previous frame.
+    uint hiz = invalid_texture_id;
+    glm::ivec2 hiz_size{0};
+    int hiz_level_count = 0;
+    bool hiz_valid = false;
+    glm::mat4 hiz_view_proj{1.f};
+
+    void cull_draws(const RenderArgs &args);
+    void build_hiz();
+
     uint fbuf;
     uint fbuf_downsample;
 
@@ -45,21 +128,37 @@ class GeometryPass
     });
 
     // FIXME: duplicate
-    Shader point_light_shader = *Shader::from_paths(ShaderPaths{
-        .vert = shaders_path / "point_light.vs",
-        .frag = shaders_path / "point_light_id.frag",
-    });
+    Shader point_light_shader = *Shader::from_paths(
+        ShaderPaths{
+            .vert = shaders_path / "point_light.vs",
+            .frag = shaders_path / "point_light_id.frag",
+        },
+        {
+            .vert = "#define MARKER_RADIUS 0.5\n",
+        });
 
     Shader downsample_shader = *Shader::from_paths(ShaderPaths{
         .vert = shaders_path / "lighting.vs",
         .frag = shaders_path / "z_downsample.frag",
     });
 
+    static constexpr uint cull_group_size = 64;
+    static constexpr glm::ivec2 hiz_group_size{8, 8};
+
+    Shader cull_shader = *Shader::from_comp_path(shaders_path / "cull.comp",
+                                                 "#define LOCAL_SIZE 64\n");
+    Shader hiz_shader = *Shader::from_comp_path(
+        shaders_path / "hiz_downsample.comp", "#define LOCAL_SIZE 8\n");
+    UniformHandle hiz_copy_depth;
+
   public:
     GeometryPass();
 
-    uint debug_view_metallic, debug_view_normal, debug_view_base_color,
-        debug_view_roughness, debug_view_velocity;
+    uint debug_view_metallic = invalid_texture_id,
+         debug_view_normal = invalid_texture_id,
+         debug_view_base_color = invalid_texture_id,
+         debug_view_roughness = invalid_texture_id,
+         debug_view_velocity = invalid_texture_id;
 
     void create_debug_views();
     void parse_parameters();
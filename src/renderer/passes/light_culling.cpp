@@ -0,0 +1,68 @@
+#include <cmath>
+
+#include <Tracy.hpp>
+#include <glm/glm.hpp>
+
+#include "renderer/passes/light_culling.hpp"
+
+using namespace engine;
+using namespace glm;
+
+LightCullingPass::LightCullingPass(Params params) : params(params)
+{
+    glCreateBuffers(1, &uniform_buf);
+    glNamedBufferData(uniform_buf, sizeof(Uniforms), nullptr, GL_DYNAMIC_DRAW);
+}
+
+void LightCullingPass::initialize(ViewportContext &ctx)
+{
+    const uint cluster_count = params.dims.x * params.dims.y * params.dims.z;
+
+    glDeleteBuffers(1, &cluster_buf);
+    glCreateBuffers(1, &cluster_buf);
+    glNamedBufferStorage(cluster_buf, cluster_count * sizeof(uvec2), nullptr,
+                         GL_NONE);
+
+    glDeleteBuffers(1, &index_buf);
+    glCreateBuffers(1, &index_buf);
+    glNamedBufferStorage(index_buf,
+                         cluster_count * params.max_cluster_lights *
+                             sizeof(uint32_t),
+                         nullptr, GL_NONE);
+
+    ctx.light_cluster_uniforms = uniform_buf;
+    ctx.light_clusters = cluster_buf;
+    ctx.light_cluster_indices = index_buf;
+}
+
+void LightCullingPass::render(ViewportContext &ctx_v, RenderContext &ctx_r)
+{
+    ZoneScoped;
+
+    const float log_range = std::log(ctx_v.far / ctx_v.near);
+
+    uniforms = {
+        .view = ctx_v.view,
+        .proj_inv = ctx_v.proj_inv,
+        .dims = params.dims,
+        .light_count = static_cast<uint>(ctx_r.lights.size()),
+        .scale = static_cast<float>(params.dims.z) / log_range,
+        .bias = static_cast<float>(params.dims.z) * std::log(ctx_v.near) /
+                log_range,
+        .near = ctx_v.near,
+        .far = ctx_v.far,
+    };
+
+    glNamedBufferSubData(uniform_buf, 0, sizeof(Uniforms), &uniforms);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, 1, uniform_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ctx_r.light_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cluster_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, index_buf);
+
+    glUseProgram(cull_shader.get_id());
+    cull_shader.set("u_max_cluster_lights", params.max_cluster_lights);
+
+    const uint cluster_count = params.dims.x * params.dims.y * params.dims.z;
+    glDispatchCompute((cluster_count + group_size - 1) / group_size, 1u, 1u);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include "constants.hpp"
+#include "renderer/context.hpp"
+#include "renderer/pass.hpp"
+
+namespace engine
+{
+
+// Bins point lights into view space froxels, so shading passes only visit
+// the lights that can reach a fragment. Slices are spaced exponentially in
+// depth between the near and far plane.
+class LightCullingPass
+{
+    struct Uniforms
+    {
+        glm::mat4 view{};
+        glm::mat4 proj_inv{};
+        glm::uvec3 dims{};
+        uint light_count = 0;
+        float scale = 0.f;
+        float bias = 0.f;
+        float near = 0.f;
+        float far = 0.f;
+    };
+
+    static constexpr int group_size = 128;
+
+    Shader cull_shader = *Shader::from_comp_path(
+        shaders_path / "light_cull.comp",
+        fmt::format("#define LOCAL_SIZE {}\n", group_size));
+
+    Uniforms uniforms;
+    uint uniform_buf;
+
+    // Offset and count into the index buffer per cluster, and the light
+    // indices themselves in fixed size slots.
+    uint cluster_buf = 0;
+    uint index_buf = 0;
+
+  public:
+    struct Params
+    {
+        glm::uvec3 dims;
+        // Lights beyond this count are dropped from a cluster.
+        uint max_cluster_lights;
+    };
+
+    Params params;
+
+    LightCullingPass(Params params);
+
+    void initialize(ViewportContext &ctx);
+    void render(ViewportContext &ctx_v, RenderContext &ctx_r);
+};
+
+static_assert(Pass<LightCullingPass>);
+
+} // namespace engine
@@ -8,6 +8,7 @@
 #include "lighting.hpp"
 #include "logger.hpp"
 #include "model.hpp"
+#include "profiler.hpp"
 #include "renderer/renderer.hpp"
 
 using namespace std;
@@ -56,6 +57,7 @@ void LightingPass::render(ViewportContext &ctx_v, RenderContext &ctx_r)
     uniforms.ambient_occlusion = params.ssao;
     uniforms.inv_grid_transform = ctx_r.inv_grid_transform;
     uniforms.grid_dims = ctx_r.grid_dims;
+    uniforms.clustered_lights = ctx_r.clustered_lights;
     uniforms.indirect_lighting =
         ctx_r.sh_texs.size() != 0 && params.indirect_light;
     uniforms.light_intensity = ctx_r.sun.intensity * ctx_r.sun.color;
@@ -83,7 +85,12 @@ void LightingPass::render(ViewportContext &ctx_v, RenderContext &ctx_r)
     glBindTextureUnit(12, ctx_v.history_tex);
     glBindTextureUnit(13, ctx_v.reflections_tex);
     glBindTextureUnit(14, ctx_v.g_buf.velocity);
-    glBindTextureUnit(15, ctx_r.light_shadows_array);
+    glBindTextureUnit(15, ctx_r.light_shadow_atlas);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ctx_r.light_shadow_rects);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 1, ctx_v.light_cluster_uniforms);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ctx_r.light_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, ctx_v.light_clusters);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ctx_v.light_cluster_indices);
 
     // TODO: UBO
     lighting_shader.set("u_light_transforms[0]", span(ctx_v.light_transforms));
@@ -93,12 +100,13 @@ void LightingPass::render(ViewportContext &ctx_v, RenderContext &ctx_r)
 
     glDisable(GL_DEPTH_TEST);
 
-    glViewport(0, 0, ctx_v.size.x, ctx_v.size.y);
+    glViewport(0, 0, ctx_v.render_size.x, ctx_v.render_size.y);
     glBindFramebuffer(GL_FRAMEBUFFER, ctx_v.hdr_frame_buf);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glUseProgram(lighting_shader.get_id());
     glDrawArrays(GL_TRIANGLES, 0, 3);
+    profiler_count_draws(1, 1);
 
     glUseProgram(point_light_shader.get_id());
 
@@ -110,26 +118,9 @@ void LightingPass::render(ViewportContext &ctx_v, RenderContext &ctx_r)
     glBlendEquation(GL_FUNC_ADD);
     glBlendFunc(GL_ONE, GL_ONE);
 
-    // TODO: instancing
-    if (params.direct_lighting)
-    {
-        int i = 0;
-        for (const auto &light : ctx_r.lights)
-        {
-            const float radius_squared = light.radius_squared(0.01f);
-
-            point_light_shader.set("u_light_idx", i);
-            point_light_shader.set("u_light.position", light.position);
-            point_light_shader.set("u_light.color",
-                                   light.intensity * light.color);
-            point_light_shader.set("u_light.radius", sqrt(radius_squared));
-            point_light_shader.set("u_light.radius_squared", radius_squared);
-
-            Renderer::render_mesh_instance(
-                ctx_r.mesh_instances[ctx_r.sphere_mesh_idx]);
-            i++;
-        }
-    }
+    if (params.direct_lighting && !ctx_r.clustered_lights)
+        Renderer::render_mesh_instances(
+            ctx_r.mesh_instances[ctx_r.sphere_mesh_idx], ctx_r.lights.size());
 
     glDisable(GL_BLEND);
     glCullFace(GL_BACK);
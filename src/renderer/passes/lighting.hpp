@@ -25,7 +25,7 @@ class LightingPass
         int reflections = false;
         int ambient_occlusion = false;
         glm::vec3 grid_dims{};
-        int _pad0 = 0.f;
+        int clustered_lights = false;
         glm::vec3 light_intensity{};
         int _pad1 = 0.f;
         glm::vec3 light_direction{};
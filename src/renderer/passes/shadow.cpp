@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <bit>
 #include <numeric>
 
 #include <Tracy.hpp>
@@ -36,10 +38,520 @@ ShadowPass::ShadowPass(Params params) : params(params)
             .geom =
                 fmt::format("#define CASCADE_COUNT {}", params.cascade_count),
         });
+
+    if (params.render_point_lights)
+    {
+        const int size = params.omni_atlas_size;
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &omni_atlas);
+        glTextureStorage2D(omni_atlas, 1, GL_DEPTH_COMPONENT32, size, size);
+        glTextureParameteri(omni_atlas, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(omni_atlas, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(omni_atlas, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(omni_atlas, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(omni_atlas, GL_TEXTURE_COMPARE_MODE,
+                            GL_COMPARE_REF_TO_TEXTURE);
+
+        const float far_depth = 1.f;
+        glClearTexImage(omni_atlas, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
+                        &far_depth);
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &omni_cache);
+        glTextureStorage2D(omni_cache, 1, GL_DEPTH_COMPONENT32, size, size);
+    }
+}
+
+static constexpr uint64_t fnv_offset = 14695981039346656037ull;
+
+// FNV-1a, used to detect changes to what a shadow map layer contains.
+template <typename T> static uint64_t hash_value(uint64_t hash, const T &value)
+{
+    const auto *bytes = reinterpret_cast<const unsigned char *>(&value);
+
+    for (size_t i = 0; i < sizeof(T); i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+
+    return hash;
+}
+
+static uint64_t hash_caster(uint64_t hash, const Entity &e)
+{
+    return hash_value(hash_value(hash, e.mesh_index), e.model);
+}
+
+// Copies a single depth layer between two texture arrays.
+static void copy_layer(uint src, int src_layer, uint dst, int dst_layer,
+                       ivec2 size)
+{
+    glCopyImageSubData(src, GL_TEXTURE_2D_ARRAY, 0, 0, 0, src_layer, dst,
+                       GL_TEXTURE_2D_ARRAY, 0, 0, 0, dst_layer, size.x, size.y,
+                       1);
+}
+
+// Copies a square region between two depth textures of the same size.
+static void copy_tile(uint src, uint dst, ivec2 offset, int size)
+{
+    glCopyImageSubData(src, GL_TEXTURE_2D, 0, offset.x, offset.y, 0, dst,
+                       GL_TEXTURE_2D, 0, offset.x, offset.y, 0, size, size, 1);
+}
+
+// Inverse of interleaving the bits of x and y.
+static ivec2 morton_decode(uint32_t code)
+{
+    const auto compact = [](uint32_t v)
+    {
+        v &= 0x55555555u;
+        v = (v | (v >> 1)) & 0x33333333u;
+        v = (v | (v >> 2)) & 0x0f0f0f0fu;
+        v = (v | (v >> 4)) & 0x00ff00ffu;
+        v = (v | (v >> 8)) & 0x0000ffffu;
+        return static_cast<int>(v);
+    };
+
+    return {compact(code), compact(code >> 1)};
+}
+
+// Radius in pixels of a sphere projected on the viewport, zero when it lies
+// outside the view frustum.
+static float projected_radius(const ViewportContext &ctx,
+                              const Frustum &frustum, const vec3 &center,
+                              float radius)
+{
+    for (const auto &p : frustum.planes)
+        if (dot(vec3(p), center) + p.w < -radius)
+            return 0.f;
+
+    const float height = static_cast<float>(ctx.size.y);
+    const vec3 to_center = center - vec3(ctx.view_inv[3]);
+    const float dist_squared = dot(to_center, to_center);
+    const float radius_squared = radius * radius;
+
+    // The camera is inside the sphere.
+    if (dist_squared <= radius_squared)
+        return height;
+
+    const float scale = 0.5f * height / tan(0.5f * ctx.fov);
+    return glm::min(height,
+                    scale * radius / sqrt(dist_squared - radius_squared));
+}
+
+static array<mat4, 6> cube_face_views(const vec3 &position)
+{
+    return {
+        lookAt(position, position + vec3{1.f, 0.f, 0.f}, vec3{0.f, -1.f, 0.f}),
+        lookAt(position, position + vec3{-1.f, 0.f, 0.f}, vec3{0.f, -1.f, 0.f}),
+        lookAt(position, position + vec3{0.f, 1.f, 0.f}, vec3{0.f, 0.f, 1.f}),
+        lookAt(position, position + vec3{0.f, -1.f, 0.f}, vec3{0.f, 0.f, -1.f}),
+        lookAt(position, position + vec3{0.f, 0.f, 1.f}, vec3{0.f, -1.f, 0.f}),
+        lookAt(position, position + vec3{0.f, 0.f, -1.f}, vec3{0.f, -1.f, 0.f}),
+    };
+}
+
+void ShadowPass::prepare_casters(const RenderContext &ctx_r)
+{
+    ZoneScoped;
+
+    models.clear();
+    caster_indices.clear();
+    caster_cascade_masks.clear();
+
+    for (size_t i = 0; i < ctx_r.queue.size(); i++)
+    {
+        if (ctx_r.queue[i].flags & Entity::casts_shadow)
+        {
+            caster_indices.push_back(i);
+            models.push_back(ctx_r.queue[i].model);
+        }
+    }
+
+    const uint32_t all_cascades = (1u << params.cascade_count) - 1;
+    cascade_masks.assign(ctx_r.queue.size(),
+                         ctx_r.cpu_culling ? 0u : all_cascades);
+
+    if (ctx_r.cpu_culling)
+    {
+        for (int c = 0; c < params.cascade_count; c++)
+            cull_frustum(ctx_r.queue_bounds, make_frustum(light_transforms[c]),
+                         cascade_masks, 1u << c);
+    }
+
+    cascade_static_draws.clear();
+    cascade_dynamic_draws.clear();
+
+    auto &signatures = cascade_signatures;
+    for (int c = 0; c < params.cascade_count; c++)
+        signatures[c] = hash_value(
+            hash_value(fnv_offset, params.cull_front_faces),
+            light_transforms[c]);
+
+    dynamic_cascades = 0;
+
+    for (uint32_t m = 0; m < caster_indices.size(); m++)
+    {
+        const auto &r = ctx_r.queue[caster_indices[m]];
+        const uint32_t mask = cascade_masks[caster_indices[m]];
+
+        caster_cascade_masks.push_back(mask);
+        if (mask == 0)
+            continue;
+
+        const auto &mesh = ctx_r.mesh_instances[r.mesh_index];
+
+        if (r.flags & Entity::dynamic)
+        {
+            cascade_dynamic_draws.push(mesh, m);
+            dynamic_cascades |= mask;
+            continue;
+        }
+
+        cascade_static_draws.push(mesh, m);
+
+        for (int c = 0; c < params.cascade_count; c++)
+            if (mask & (1u << c))
+                signatures[c] = hash_caster(signatures[c], r);
+    }
+
+    cascade_static_draws.upload();
+    cascade_dynamic_draws.upload();
+
+    // The caches aren't kept up to date while caching is off.
+    if (!params.cache_static)
+    {
+        for (auto &layer : cascade_layers)
+            layer.valid = false;
+        for (auto &layer : omni_layers)
+            layer.valid = false;
+    }
+
+    dirty_cascades = 0;
+    for (int c = 0; c < params.cascade_count; c++)
+    {
+        const auto &layer = cascade_layers[c];
+
+        if (!layer.valid || layer.signature != signatures[c])
+            dirty_cascades |= 1u << c;
+    }
+
+    if (params.render_point_lights)
+        prepare_omni_casters(ctx_r);
+
+    if (models.size() > model_capacity)
+    {
+        model_capacity = std::max<uint32_t>(models.size(), 2 * model_capacity);
+
+        glDeleteBuffers(1, &model_buf);
+        glCreateBuffers(1, &model_buf);
+        glNamedBufferStorage(model_buf, model_capacity * sizeof(mat4), nullptr,
+                             GL_DYNAMIC_STORAGE_BIT);
+
+        glDeleteBuffers(1, &cascade_mask_buf);
+        glCreateBuffers(1, &cascade_mask_buf);
+        glNamedBufferStorage(cascade_mask_buf,
+                             model_capacity * sizeof(uint32_t), nullptr,
+                             GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    if (!models.empty())
+    {
+        glNamedBufferSubData(model_buf, 0, models.size() * sizeof(mat4),
+                             models.data());
+        glNamedBufferSubData(cascade_mask_buf, 0,
+                             caster_cascade_masks.size() * sizeof(uint32_t),
+                             caster_cascade_masks.data());
+    }
+}
+
+void ShadowPass::prepare_omni_casters(const RenderContext &ctx_r)
+{
+    ZoneScoped;
+
+    omni_draws.clear();
+    omni_faces.clear();
+
+    for (const auto &l : ctx_r.lights)
+    {
+        const float far = glm::sqrt(l.radius_squared(0.01f));
+        const mat4 proj = perspective(radians(90.f), 1.f, 0.01f, far);
+        const auto views = cube_face_views(l.position);
+
+        // The far plane of each face lies on the light radius.
+        face_masks.assign(ctx_r.queue.size(), ctx_r.cpu_culling ? 0u : 0x3fu);
+
+        if (ctx_r.cpu_culling)
+        {
+            for (uint32_t f = 0; f < 6; f++)
+                cull_frustum(ctx_r.queue_bounds, make_frustum(proj * views[f]),
+                             face_masks, 1u << f);
+        }
+
+        for (uint32_t f = 0; f < 6; f++)
+        {
+            OmniFace face{
+                .view_proj = proj * views[f],
+                .far = far,
+            };
+
+            face.signature = hash_value(
+                hash_value(fnv_offset, params.cull_front_faces),
+                face.view_proj);
+
+            // Static casters first, then dynamic ones.
+            for (const bool dynamic : {false, true})
+            {
+                const size_t first = omni_draws.commands.size();
+
+                for (uint32_t m = 0; m < caster_indices.size(); m++)
+                {
+                    const auto &r = ctx_r.queue[caster_indices[m]];
+
+                    if ((face_masks[caster_indices[m]] & (1u << f)) == 0 ||
+                        static_cast<bool>(r.flags & Entity::dynamic) != dynamic)
+                        continue;
+
+                    omni_draws.push(ctx_r.mesh_instances[r.mesh_index], m);
+
+                    if (!dynamic)
+                        face.signature = hash_caster(face.signature, r);
+                }
+
+                (dynamic ? face.dynamic_first : face.static_first) = first;
+                (dynamic ? face.dynamic_count : face.static_count) =
+                    omni_draws.commands.size() - first;
+            }
+
+            omni_faces.push_back(face);
+        }
+    }
+
+    omni_draws.upload();
+
+    if (omni_layers.size() != omni_faces.size())
+    {
+        omni_layers.assign(omni_faces.size(), CachedLayer{});
+        omni_tiles.assign(omni_faces.size(), AtlasTile{});
+        omni_tile_sizes.assign(ctx_r.lights.size(), 0);
+    }
+}
+
+void ShadowPass::place_omni_tiles(const ViewportContext &ctx,
+                                  const RenderContext &ctx_r)
+{
+    ZoneScoped;
+
+    const size_t light_count = ctx_r.lights.size();
+    const int min_tile = params.omni_min_tile;
+    const Frustum frustum = make_frustum(ctx.view_proj);
+
+    omni_importance.resize(light_count);
+
+    for (size_t i = 0; i < light_count; i++)
+    {
+        const float radius = projected_radius(
+            ctx, frustum, ctx_r.lights[i].position, omni_faces[6 * i].far);
+        omni_importance[i] = radius;
+
+        // A face covers about half of the light's screen space diameter.
+        int size = static_cast<int>(bit_ceil(static_cast<uint32_t>(radius)));
+        size = std::clamp(size, min_tile, params.omni_max_tile);
+
+        // Don't shrink by a single step, otherwise lights near a size
+        // boundary keep moving around the atlas.
+        if (2 * size == omni_tile_sizes[i])
+            size = omni_tile_sizes[i];
+
+        omni_tile_sizes[i] = size;
+    }
+
+    vector<uint32_t> order(light_count);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+                { return omni_tile_sizes[a] > omni_tile_sizes[b]; });
+
+    // Tiles are packed along a Z-order curve of min_tile cells, largest
+    // first, so every tile starts at a multiple of its own size.
+    const uint32_t cells_per_side = params.omni_atlas_size / min_tile;
+    const uint32_t cell_count = cells_per_side * cells_per_side;
+    uint32_t cursor = 0;
+    int max_size = params.omni_max_tile;
+
+    const auto cells = [min_tile](int size)
+    { return static_cast<uint32_t>((size / min_tile) * (size / min_tile)); };
+
+    for (const uint32_t light_idx : order)
+    {
+        int size = std::min(omni_tile_sizes[light_idx], max_size);
+
+        // Shrink the remaining lights once the atlas fills up, lights that
+        // don't fit at all are left without shadows.
+        while (size >= min_tile && cursor + 6 * cells(size) > cell_count)
+            size /= 2;
+
+        max_size = size;
+
+        for (uint32_t f = 0; f < 6; f++)
+        {
+            const uint32_t face_idx = 6 * light_idx + f;
+            AtlasTile placed{};
+
+            if (size >= min_tile)
+            {
+                placed.offset = morton_decode(cursor) * min_tile;
+                placed.size = size;
+                cursor += cells(size);
+            }
+
+            auto &tile = omni_tiles[face_idx];
+            if (tile.offset != placed.offset || tile.size != placed.size)
+            {
+                tile = placed;
+                omni_layers[face_idx].valid = false;
+            }
+        }
+    }
+}
+
+void ShadowPass::schedule_omni_updates()
+{
+    ZoneScoped;
+
+    frame++;
+    omni_updates.clear();
+
+    for (uint32_t i = 0; i < omni_faces.size(); i++)
+    {
+        const auto &tile = omni_tiles[i];
+        const auto &layer = omni_layers[i];
+        const auto &face = omni_faces[i];
+
+        if (tile.size == 0)
+            continue;
+
+        const bool dirty = !params.cache_static || !layer.valid ||
+                           layer.signature != face.signature;
+
+        if (tile.rendered && !dirty && face.dynamic_count == 0 &&
+            !layer.had_dynamic)
+            continue;
+
+        omni_updates.push_back(i);
+    }
+
+    const size_t budget = std::max(params.omni_face_budget, 0);
+    if (omni_updates.size() <= budget)
+        return;
+
+    // Faces without any depth at their placement go first. The others are
+    // ordered by the size of their light on screen and the frames since
+    // their last update, so faces of distant lights still get their turn.
+    const auto priority = [this](uint32_t i)
+    {
+        return (1.f + omni_importance[i / 6]) *
+               static_cast<float>(frame - omni_tiles[i].updated_frame);
+    };
+
+    partial_sort(omni_updates.begin(), omni_updates.begin() + budget,
+                 omni_updates.end(),
+                 [&](uint32_t a, uint32_t b)
+                 {
+                     if (omni_tiles[a].rendered != omni_tiles[b].rendered)
+                         return !omni_tiles[a].rendered;
+
+                     return priority(a) > priority(b);
+                 });
+
+    omni_updates.resize(budget);
+}
+
+void ShadowPass::render_omni(const RenderContext &ctx_r)
+{
+    ZoneScoped;
+
+    glNamedFramebufferTexture(frame_buf, GL_DEPTH_ATTACHMENT, omni_atlas, 0);
+
+    glUseProgram(omni_shader.get_id());
+
+    const float far_depth = 1.f;
+
+    for (const uint32_t face_idx : omni_updates)
+    {
+        const auto &face = omni_faces[face_idx];
+        auto &tile = omni_tiles[face_idx];
+        auto &layer = omni_layers[face_idx];
+
+        const bool dirty = !params.cache_static || !layer.valid ||
+                           layer.signature != face.signature;
+
+        if (dirty)
+            glClearTexSubImage(omni_atlas, 0, tile.offset.x, tile.offset.y, 0,
+                               tile.size, tile.size, 1, GL_DEPTH_COMPONENT,
+                               GL_FLOAT, &far_depth);
+        // Remove dynamic casters of the previous update.
+        else
+            copy_tile(omni_cache, omni_atlas, tile.offset, tile.size);
+
+        glViewport(tile.offset.x, tile.offset.y, tile.size, tile.size);
+
+        omni_shader.set(omni_light_position,
+                        ctx_r.lights[face_idx / 6].position);
+        omni_shader.set(omni_far, face.far);
+        omni_shader.set(omni_view_proj, face.view_proj);
+
+        if (dirty)
+        {
+            omni_draws.draw(face.static_first, face.static_count,
+                            ctx_r.indirect_draws);
+
+            if (params.cache_static)
+            {
+                copy_tile(omni_atlas, omni_cache, tile.offset, tile.size);
+                layer.signature = face.signature;
+                layer.valid = true;
+            }
+        }
+
+        omni_draws.draw(face.dynamic_first, face.dynamic_count,
+                        ctx_r.indirect_draws);
+
+        layer.had_dynamic = face.dynamic_count > 0;
+        tile.rendered = true;
+        tile.updated_frame = frame;
+    }
+
+    // Tiles that weren't rendered since they moved would show the depth of
+    // another face, leave them unshadowed instead.
+    const float texel_size = 1.f / static_cast<float>(params.omni_atlas_size);
+
+    omni_rects.resize(omni_tiles.size());
+    for (size_t i = 0; i < omni_tiles.size(); i++)
+    {
+        const auto &tile = omni_tiles[i];
+        const float size = static_cast<float>(tile.size) * texel_size;
+
+        omni_rects[i] = tile.rendered
+                            ? vec4{vec2(tile.offset) * texel_size, size, size}
+                            : vec4{0.f};
+    }
+
+    if (omni_rects.size() > omni_rect_capacity)
+    {
+        omni_rect_capacity = omni_rects.size();
+
+        glDeleteBuffers(1, &omni_rect_buf);
+        glCreateBuffers(1, &omni_rect_buf);
+        glNamedBufferStorage(omni_rect_buf, omni_rect_capacity * sizeof(vec4),
+                             nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    glNamedBufferSubData(omni_rect_buf, 0, omni_rects.size() * sizeof(vec4),
+                         omni_rects.data());
 }
 
 void ShadowPass::initialize(ViewportContext &ctx)
 {
+    omni_light_position = omni_shader.uniform("u_light_position");
+    omni_far = omni_shader.uniform("u_far");
+    omni_view_proj = omni_shader.uniform("u_view_proj");
+
     // Split scheme. Source:
     // https://developer.nvidia.com/gpugems/gpugems3/part-ii-light-and-shadows/chapter-10-parallel-split-shadow-maps-programmable-gpus
     float lambda = 0.6f;
@@ -71,6 +583,13 @@ void ShadowPass::initialize(ViewportContext &ctx)
     glTextureStorage3D(shadow_map, 1, GL_DEPTH_COMPONENT32, params.size.x,
                        params.size.y, params.cascade_count);
 
+    if (params.cache_static)
+    {
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &cascade_cache);
+        glTextureStorage3D(cascade_cache, 1, GL_DEPTH_COMPONENT32,
+                           params.size.x, params.size.y, params.cascade_count);
+    }
+
     glGenTextures(params.cascade_count, debug_views.data());
 
     for (int i = 0; i < params.cascade_count; i++)
@@ -92,7 +611,6 @@ void ShadowPass::render(ViewportContext &ctx, RenderContext &ctx_r)
 
     glViewport(0, 0, params.size.x, params.size.y);
     glBindFramebuffer(GL_FRAMEBUFFER, frame_buf);
-    glClear(GL_DEPTH_BUFFER_BIT);
 
     float aspect_ratio =
         static_cast<float>(ctx.size.x) / static_cast<float>(ctx.size.y);
@@ -187,74 +705,66 @@ void ShadowPass::render(ViewportContext &ctx, RenderContext &ctx_r)
 
     directional_shader.set("u_light_transforms[0]", span(light_transforms));
 
+    prepare_casters(ctx_r);
+
     glBindVertexArray(ctx_r.entity_vao);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, model_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cascade_mask_buf);
 
     // Peter panning.
     if (params.cull_front_faces)
         glCullFace(GL_FRONT);
 
-    for (const auto &r : ctx_r.queue)
+    const float far_depth = 1.f;
+    const bool cache =
+        params.cache_static && cascade_cache != invalid_texture_id;
+
+    for (int c = 0; c < params.cascade_count; c++)
     {
-        if (r.flags & Entity::casts_shadow)
-        {
-            directional_shader.set("u_model", r.model);
-            Renderer::render_mesh_instance(ctx_r.mesh_instances[r.mesh_index]);
-        }
+        auto &layer = cascade_layers[c];
+        const uint32_t bit = 1u << c;
+
+        if (dirty_cascades & bit)
+            glClearTexSubImage(shadow_map, 0, 0, 0, c, params.size.x,
+                               params.size.y, 1, GL_DEPTH_COMPONENT, GL_FLOAT,
+                               &far_depth);
+        // Remove dynamic casters of the previous frame.
+        else if ((dynamic_cascades & bit) || layer.had_dynamic)
+            copy_layer(cascade_cache, c, shadow_map, c, params.size);
+
+        layer.had_dynamic = dynamic_cascades & bit;
     }
 
-    if (params.render_point_lights)
+    if (dirty_cascades != 0)
     {
-        glViewport(0, 0, 1024, 1024);
-
-        glUseProgram(omni_shader.get_id());
+        directional_shader.set("u_cascade_mask", dirty_cascades);
+        cascade_static_draws.draw(ctx_r.indirect_draws);
 
-        for (auto light_idx = 0; light_idx < ctx_r.lights.size(); light_idx++)
+        for (int c = 0; c < params.cascade_count; c++)
         {
-            const Light &l = ctx_r.lights[light_idx];
-            const float far = glm::sqrt(l.radius_squared(0.01f));
-
-            const mat4 proj = perspective(radians(90.f), 1.f, 0.01f, far);
-
-            const array<mat4, 6> views{
-                lookAt(l.position, l.position + vec3{1.f, 0.f, 0.f},
-                       vec3{0.f, -1.f, 0.f}),
-                lookAt(l.position, l.position + vec3{-1.f, 0.f, 0.f},
-                       vec3{0.f, -1.f, 0.f}),
-                lookAt(l.position, l.position + vec3{0.f, 1.f, 0.f},
-                       vec3{0.f, 0.f, 1.f}),
-                lookAt(l.position, l.position + vec3{0.f, -1.f, 0.f},
-                       vec3{0.f, 0.f, -1.f}),
-                lookAt(l.position, l.position + vec3{0.f, 0.f, 1.f},
-                       vec3{0.f, -1.f, 0.f}),
-                lookAt(l.position, l.position + vec3{0.f, 0.f, -1.f},
-                       vec3{0.f, -1.f, 0.f}),
-            };
-
-            omni_shader.set("u_light_position", l.position);
-            omni_shader.set("u_far", far);
-
-            for (int face_idx = 0; face_idx < 6; face_idx++)
+            if (cache && (dirty_cascades & (1u << c)))
             {
-                glNamedFramebufferTextureLayer(frame_buf, GL_DEPTH_ATTACHMENT,
-                                               ctx_r.light_shadows_array, 0,
-                                               (6 * light_idx) + face_idx);
-                glClear(GL_DEPTH_BUFFER_BIT);
+                copy_layer(shadow_map, c, cascade_cache, c, params.size);
+                cascade_layers[c].signature = cascade_signatures[c];
+                cascade_layers[c].valid = true;
+            }
+        }
+    }
 
-                mat4 view_proj = proj * views[face_idx];
-                omni_shader.set("u_view_proj", view_proj);
+    if (dynamic_cascades != 0)
+    {
+        directional_shader.set("u_cascade_mask", dynamic_cascades);
+        cascade_dynamic_draws.draw(ctx_r.indirect_draws);
+    }
 
-                for (const auto &r : ctx_r.queue)
-                {
-                    if (r.flags & Entity::casts_shadow)
-                    {
-                        omni_shader.set("u_model", r.model);
+    if (params.render_point_lights && !ctx_r.lights.empty())
+    {
+        place_omni_tiles(ctx, ctx_r);
+        schedule_omni_updates();
+        render_omni(ctx_r);
 
-                        Renderer::render_mesh_instance(
-                            ctx_r.mesh_instances[r.mesh_index]);
-                    }
-                }
-            }
-        }
+        ctx_r.light_shadow_atlas = omni_atlas;
+        ctx_r.light_shadow_rects = omni_rect_buf;
     }
 
     if (params.cull_front_faces)
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <vector>
+
 #include "renderer/context.hpp"
+#include "renderer/indirect_buffer.hpp"
 #include "renderer/pass.hpp"
 
 namespace engine
@@ -18,6 +21,26 @@ class ShadowPass
         float z_multiplier;
         bool cull_front_faces;
         bool render_point_lights;
+        // Keep the depth of static casters between frames, and only render
+        // a cascade or cube face again when it changes.
+        bool cache_static = true;
+        // Point light faces share a single atlas. Tile sizes are powers of
+        // two between the min and max, picked by the screen space size of
+        // the light.
+        int omni_atlas_size = 4096;
+        int omni_min_tile = 128;
+        int omni_max_tile = 1024;
+        // Cube faces rendered per frame, the most important and stalest
+        // faces go first.
+        int omni_face_budget = 18;
+    };
+
+    // Cached static depth of a cascade or cube face.
+    struct CachedLayer
+    {
+        uint64_t signature = 0;
+        bool valid = false;
+        bool had_dynamic = false;
     };
 
     uint frame_buf;
@@ -27,11 +50,93 @@ class ShadowPass
         .vert = shaders_path / "shadow_omni.vert",
         .frag = shaders_path / "shadow_omni.frag",
     });
+    // Set once per cube face, resolved in initialize.
+    UniformHandle omni_light_position;
+    UniformHandle omni_far;
+    UniformHandle omni_view_proj;
     uint shadow_map;
 
     std::array<float, max_cascade_count> cascade_distances;
     std::array<glm::mat4, max_cascade_count> light_transforms;
 
+    // Draws of a single cube face of a point light shadow map.
+    struct OmniFace
+    {
+        glm::mat4 view_proj;
+        float far;
+        size_t static_first;
+        size_t static_count;
+        size_t dynamic_first;
+        size_t dynamic_count;
+        // Identifies the light and the static casters drawn into the face.
+        uint64_t signature;
+    };
+
+    // Model matrices of the shadow casters, indexed by base instance, and the
+    // cascades each caster overlaps.
+    std::vector<glm::mat4> models;
+    std::vector<uint32_t> caster_cascade_masks;
+    std::vector<size_t> caster_indices;
+    uint model_buf = 0;
+    uint cascade_mask_buf = 0;
+    uint32_t model_capacity = 0;
+
+    // Casters inside any cascade. The geometry shader skips cascades a
+    // caster doesn't overlap.
+    IndirectBuffer cascade_static_draws{};
+    IndirectBuffer cascade_dynamic_draws{};
+    std::vector<uint32_t> cascade_masks;
+
+    // Static depth of each cascade, and the cascades that need static
+    // casters drawn or dynamic casters composited this frame.
+    uint cascade_cache = invalid_texture_id;
+    std::array<CachedLayer, max_cascade_count> cascade_layers{};
+    // Of this frame's static casters, a layer takes its signature once the
+    // cache is rewritten.
+    std::array<uint64_t, max_cascade_count> cascade_signatures{};
+    uint32_t dirty_cascades = 0;
+    uint32_t dynamic_cascades = 0;
+
+    // Commands of all cube faces, six faces per light.
+    IndirectBuffer omni_draws{};
+    std::vector<OmniFace> omni_faces;
+    std::vector<uint32_t> face_masks;
+
+    // Placement of a cube face in the point light atlas.
+    struct AtlasTile
+    {
+        glm::ivec2 offset{0};
+        // Zero when the atlas had no room left.
+        int size = 0;
+        // Whether the tile holds depth rendered at its current placement.
+        bool rendered = false;
+        uint64_t updated_frame = 0;
+    };
+
+    // Depth of all cube faces, and the static depth of each face at the
+    // same placement.
+    uint omni_atlas = invalid_texture_id;
+    uint omni_cache = invalid_texture_id;
+    std::vector<CachedLayer> omni_layers;
+    std::vector<AtlasTile> omni_tiles;
+    std::vector<int> omni_tile_sizes;
+    std::vector<float> omni_importance;
+    // Atlas rectangles of the faces in texture coordinates, read by the
+    // lighting passes.
+    std::vector<glm::vec4> omni_rects;
+    uint omni_rect_buf = 0;
+    size_t omni_rect_capacity = 0;
+    // Faces rendered this frame.
+    std::vector<uint32_t> omni_updates;
+    uint64_t frame = 0;
+
+    void prepare_casters(const RenderContext &ctx_r);
+    void prepare_omni_casters(const RenderContext &ctx_r);
+    void place_omni_tiles(const ViewportContext &ctx,
+                          const RenderContext &ctx_r);
+    void schedule_omni_updates();
+    void render_omni(const RenderContext &ctx_r);
+
   public:
     Params params;
 
@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 
 #include "logger.hpp"
+#include "profiler.hpp"
+#include "renderer/texture_pool.hpp"
 #include "ssao.hpp"
 
 using namespace std;
@@ -50,8 +52,6 @@ SsaoPass::SsaoPass(SsaoConfig cfg)
     glCreateBuffers(1, &ubo);
     glNamedBufferData(ubo, sizeof(SsaoData), nullptr, GL_DYNAMIC_DRAW);
 
-    ssao.set("u_kernel[0]", span(kernel));
-
     data = {
         .kernel_size = cfg.kernel_size,
         .sample_count = cfg.sample_count,
@@ -65,14 +65,15 @@ SsaoPass::SsaoPass(SsaoConfig cfg)
 
 void SsaoPass::initialize(ViewportContext &ctx)
 {
-    glDeleteTextures(2, &ao_tex);
-    glCreateTextures(GL_TEXTURE_2D, 2, &ao_tex);
+    ssao.set("u_kernel[0]", span(kernel));
+
+    texture_pool.release(ao_tex);
+    texture_pool.release(ao_blur_tex);
 
-    glTextureParameteri(ao_tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(ao_tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    const TextureDesc desc{.size = ctx.render_size, .format = GL_R8};
 
-    glTextureStorage2D(ao_tex, 1, GL_R8, ctx.size.x, ctx.size.y);
-    glTextureStorage2D(ao_blur_tex, 1, GL_R8, ctx.size.x, ctx.size.y);
+    ao_tex = texture_pool.acquire(desc);
+    ao_blur_tex = texture_pool.acquire(desc);
 
     glNamedFramebufferTexture(frame_buf, GL_COLOR_ATTACHMENT0, ao_tex, 0);
     glNamedFramebufferTexture(frame_buf, GL_COLOR_ATTACHMENT1, ao_blur_tex, 0);
@@ -100,13 +101,13 @@ void SsaoPass::render(ViewportContext &ctx)
 {
     ZoneScoped;
 
-    glViewport(0, 0, ctx.size.x, ctx.size.y);
+    glViewport(0, 0, ctx.render_size.x, ctx.render_size.y);
     glBindFramebuffer(GL_FRAMEBUFFER, frame_buf);
     // FIXME: Causes artifacts, why?
     // glClear(GL_COLOR_BUFFER_BIT);
 
     data.proj = ctx.proj;
-    data.noise_scale = static_cast<vec2>(ctx.size) / 4.f;
+    data.noise_scale = static_cast<vec2>(ctx.render_size) / 4.f;
 
     glNamedBufferSubData(ubo, 0, sizeof(SsaoData), &data);
 
@@ -119,9 +120,11 @@ void SsaoPass::render(ViewportContext &ctx)
 
     glUseProgram(ssao.get_id());
     glDrawArrays(GL_TRIANGLES, 0, 3);
+    profiler_count_draws(1, 1);
 
     glBindTextureUnit(0, ao_tex);
 
     glUseProgram(blur.get_id());
     glDrawArrays(GL_TRIANGLES, 0, 3);
+    profiler_count_draws(1, 1);
 }
\ No newline at end of file
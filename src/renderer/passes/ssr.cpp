@@ -4,6 +4,7 @@
 #include "logger.hpp"
 #include "profiler.hpp"
 #include "renderer/context.hpp"
+#include "renderer/texture_pool.hpp"
 #include "ssr.hpp"
 
 using namespace std;
@@ -15,6 +16,8 @@ SsrPass::SsrPass(SsrConfig cfg)
                                .frag = shaders_path / "ssr.fs"})),
       cfg(cfg)
 {
+    glCreateFramebuffers(1, &frame_buf);
+
     parse_parameters();
 }
 
@@ -29,16 +32,9 @@ void SsrPass::parse_parameters()
 
 void SsrPass::initialize(ViewportContext &ctx)
 {
-    glDeleteTextures(1, &ctx.reflections_tex);
-    glCreateTextures(GL_TEXTURE_2D, 1, &ctx.reflections_tex);
-    glCreateFramebuffers(1, &frame_buf);
-
-    // TODO:
-    glTextureParameteri(ctx.reflections_tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTextureParameteri(ctx.reflections_tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTextureStorage2D(ctx.reflections_tex, 1, GL_RGBA8, ctx.size.x,
-                       ctx.size.y);
+    texture_pool.release(ctx.reflections_tex);
+    ctx.reflections_tex =
+        texture_pool.acquire({.size = ctx.render_size, .format = GL_RGBA8});
 
     array<GLenum, 1> draw_bufs{GL_COLOR_ATTACHMENT0};
     glNamedFramebufferTexture(frame_buf, draw_bufs[0], ctx.reflections_tex, 0);
@@ -54,7 +50,7 @@ void SsrPass::render(ViewportContext &ctx, RenderContext &ctx_r)
 {
     ZoneScoped;
 
-    glViewport(0, 0, ctx.size.x, ctx.size.y);
+    glViewport(0, 0, ctx.render_size.x, ctx.render_size.y);
     glBindFramebuffer(GL_FRAMEBUFFER, frame_buf);
     glClear(GL_COLOR_BUFFER_BIT);
 
@@ -68,4 +64,5 @@ void SsrPass::render(ViewportContext &ctx, RenderContext &ctx_r)
 
     glUseProgram(ssr.get_id());
     glDrawArrays(GL_TRIANGLES, 0, 3);
+    profiler_count_draws(1, 1);
 }
\ No newline at end of file
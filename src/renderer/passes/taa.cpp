@@ -25,6 +25,7 @@ void TaaPass::render(const RenderArgs &args)
     uniform_data.proj = args.proj;
     uniform_data.proj_inv = args.proj_inv;
     uniform_data.size = args.size;
+    uniform_data.source_size = args.source_size;
     glNamedBufferSubData(uniform_buf, 0, sizeof(Uniforms), &uniform_data);
 
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniform_buf);
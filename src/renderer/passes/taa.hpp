@@ -18,13 +18,16 @@ class TaaPass
         glm::ivec2 size{};
         int filter;
         int flags;
+        glm::ivec2 source_size{};
     };
 
     struct RenderArgs
     {
         glm::mat4 proj;
         glm::mat4 proj_inv;
+        // Output size, the source is upsampled when it's smaller.
         glm::ivec2 size;
+        glm::ivec2 source_size;
         uint source_tex;
         uint target_tex;
         uint history_tex;
@@ -3,6 +3,7 @@
 #include <Tracy.hpp>
 #include <glad/glad.h>
 
+#include "profiler.hpp"
 #include "tone_map.hpp"
 
 using namespace engine;
@@ -74,4 +75,5 @@ void ToneMapPass::render(ViewportContext &ctx_v, RenderContext &ctx_r,
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glUseProgram(tonemap_shader.get_id());
     glDrawArrays(GL_TRIANGLES, 0, 3);
+    profiler_count_draws(1, 1);
 }
\ No newline at end of file
@@ -13,7 +13,7 @@ VolumetricPass::VolumetricPass(Params params) : params(params)
     glCreateBuffers(1, &uniform_buf);
     glNamedBufferData(uniform_buf, sizeof(Uniforms), nullptr, GL_DYNAMIC_DRAW);
 
-    glCreateFramebuffers(2, &framebuf);
+    glCreateFramebuffers(1, &framebuf);
     glNamedFramebufferDrawBuffer(framebuf, GL_COLOR_ATTACHMENT0);
 
     parse_parameters();
@@ -30,29 +30,21 @@ void VolumetricPass::parse_parameters()
     };
 }
 
-void VolumetricPass::initialize(ViewportContext &ctx)
+TextureDesc VolumetricPass::scatter_desc(glm::ivec2 size) const
 {
-    glDeleteTextures(2, &tex1);
-    glCreateTextures(GL_TEXTURE_2D, 2, &tex1);
-
-    glTextureParameteri(tex1, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(tex1, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glTextureParameteri(tex2, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(tex2, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glTextureStorage2D(tex1, 1, GL_RGBA16F, ctx.size.x / 2, ctx.size.y / 2);
-    glTextureStorage2D(tex2, 1, GL_RGBA16F, ctx.size.x / 2, ctx.size.y / 2);
-
-    glNamedFramebufferTexture(framebuf, GL_COLOR_ATTACHMENT0, tex1, 0);
-
-    if (glCheckNamedFramebufferStatus(framebuf, GL_FRAMEBUFFER) !=
-        GL_FRAMEBUFFER_COMPLETE)
-        logger.error("Volumetrics framebuffer incomplete");
+    return {
+        .size = size / 2,
+        .format = GL_RGBA16F,
+        .levels = 1,
+        .min_filter = GL_NEAREST_MIPMAP_LINEAR,
+        .mag_filter = GL_LINEAR,
+    };
 }
 
+void VolumetricPass::initialize(ViewportContext &ctx) {}
+
 void VolumetricPass::render(ViewportContext &ctx_v, RenderContext &ctx_r,
-                            uint target_tex)
+                            uint target_tex, uint scatter_tex, uint blur_tex)
 {
     uniform_data.view = ctx_v.view;
     uniform_data.proj = ctx_v.proj;
@@ -62,6 +54,7 @@ void VolumetricPass::render(ViewportContext &ctx_v, RenderContext &ctx_r,
     uniform_data.sun_dir =
         normalize(vec3(ctx_v.view * vec4(ctx_r.sun.direction, 0.f)));
     uniform_data.sun_color = ctx_r.sun.color * ctx_r.sun.intensity;
+    uniform_data.clustered_lights = ctx_r.clustered_lights;
     glNamedBufferSubData(uniform_buf, 0, sizeof(Uniforms), &uniform_data);
 
     // FIXME:
@@ -71,12 +64,17 @@ void VolumetricPass::render(ViewportContext &ctx_v, RenderContext &ctx_r,
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniform_buf);
     glBindTextureUnit(1, ctx_v.g_buf.depth);
     glBindTextureUnit(2, ctx_v.shadow_map);
-    glBindTextureUnit(3, tex1);
-    glBindTextureUnit(4, tex2);
-    glBindTextureUnit(5, ctx_r.light_shadows_array);
-
-    glBindImageTexture(5, tex1, 0, false, 0, GL_WRITE_ONLY, GL_RGBA16F);
-    glBindImageTexture(6, tex2, 0, false, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glBindTextureUnit(3, scatter_tex);
+    glBindTextureUnit(4, blur_tex);
+    glBindTextureUnit(5, ctx_r.light_shadow_atlas);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ctx_r.light_shadow_rects);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 1, ctx_v.light_cluster_uniforms);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ctx_r.light_buf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, ctx_v.light_clusters);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ctx_v.light_cluster_indices);
+
+    glBindImageTexture(5, scatter_tex, 0, false, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glBindImageTexture(6, blur_tex, 0, false, 0, GL_WRITE_ONLY, GL_RGBA16F);
     glBindImageTexture(7, target_tex, 0, false, 0, GL_READ_WRITE, GL_RGBA16F);
 
     uvec2 half_group_count =
@@ -88,38 +86,35 @@ void VolumetricPass::render(ViewportContext &ctx_v, RenderContext &ctx_r,
     glUseProgram(sun_shader.get_id());
     glDispatchCompute(half_group_count.x, half_group_count.y, 1u);
 
-    glViewport(0, 0, ctx_v.size.x / 2, ctx_v.size.y / 2);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuf);
+    // Clustered point lights are marched together with the sun.
+    if (!ctx_r.clustered_lights)
+    {
+        // The scatter target changes between frames.
+        glNamedFramebufferTexture(framebuf, GL_COLOR_ATTACHMENT0, scatter_tex,
+                                  0);
 
-    glCullFace(GL_FRONT);
-    glEnable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_ONE, GL_ONE);
+        glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
 
-    glUseProgram(point_light_shader.get_id());
-    glBindVertexArray(ctx_r.entity_vao);
+        glViewport(0, 0, ctx_v.size.x / 2, ctx_v.size.y / 2);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuf);
 
-    point_light_shader.set("u_view_proj", ctx_v.view_proj);
+        glCullFace(GL_FRONT);
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_ONE, GL_ONE);
 
-    int i = 0;
-    for (const auto &light : ctx_r.lights)
-    {
-        const float radius_squared = light.radius_squared(0.01f);
+        glUseProgram(point_light_shader.get_id());
+        glBindVertexArray(ctx_r.entity_vao);
 
-        point_light_shader.set("u_light_idx", i);
-        point_light_shader.set("u_light.position", light.position);
-        point_light_shader.set("u_light.color", light.intensity * light.color);
-        point_light_shader.set("u_light.radius", sqrt(radius_squared));
-        point_light_shader.set("u_light.radius_squared", radius_squared);
+        point_light_shader.set("u_view_proj", ctx_v.view_proj);
 
-        Renderer::render_mesh_instance(
-            ctx_r.mesh_instances[ctx_r.sphere_mesh_idx]);
-        i++;
-    }
+        Renderer::render_mesh_instances(
+            ctx_r.mesh_instances[ctx_r.sphere_mesh_idx], ctx_r.lights.size());
 
-    glDepthMask(GL_TRUE);
-    glDisable(GL_BLEND);
-    glCullFace(GL_BACK);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        glCullFace(GL_BACK);
+    }
 
     if (params.flags & Flags::blur)
     {
@@ -138,6 +133,4 @@ void VolumetricPass::render(ViewportContext &ctx_v, RenderContext &ctx_r,
 
     glUseProgram(upsample_shader.get_id());
     glDispatchCompute(group_count.x, group_count.y, 1u);
-
-    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
 }
\ No newline at end of file
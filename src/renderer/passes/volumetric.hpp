@@ -7,6 +7,7 @@
 #include "constants.hpp"
 #include "renderer/context.hpp"
 #include "renderer/pass.hpp"
+#include "renderer/render_graph.hpp"
 
 namespace engine
 {
@@ -26,6 +27,7 @@ class VolumetricPass
         bool bilateral_upsample = false;
         glm::vec3 sun_color{};
         float scatter_amount = 0.f;
+        int clustered_lights = false;
     };
 
     static constexpr int group_size = 32;
@@ -58,9 +60,6 @@ class VolumetricPass
 
     uint framebuf;
 
-    uint tex1 = invalid_texture_id;
-    uint tex2 = invalid_texture_id;
-
   public:
     bool enabled = true;
 
@@ -84,8 +83,12 @@ class VolumetricPass
     VolumetricPass(Params params);
 
     void parse_parameters();
+    // Half resolution scattering and blur targets, transient to the pass.
+    TextureDesc scatter_desc(glm::ivec2 size) const;
+
     void initialize(ViewportContext &ctx);
-    void render(ViewportContext &ctx_v, RenderContext &ctx_r, uint target_tex);
+    void render(ViewportContext &ctx_v, RenderContext &ctx_r, uint target_tex,
+                uint scatter_tex, uint blur_tex);
 };
 
 } // namespace engine
\ No newline at end of file
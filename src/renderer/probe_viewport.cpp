@@ -29,9 +29,13 @@ ProbeViewport::ProbeViewport()
 
     project = *Shader::from_comp_path(shaders_path / "sh_project.comp");
     reduce = *Shader::from_comp_path(shaders_path / "sh_reduce.comp");
+}
 
+void ProbeViewport::initialize()
+{
     shadow.initialize(ctx);
     geometry.initialize(ctx);
+    light_culling.initialize(ctx);
     lighting.initialize(ctx);
     forward.initialize(ctx);
 }
@@ -61,6 +65,11 @@ void ProbeViewport::render(RenderContext &ctx_r)
         ctx.view_proj = ctx.proj * ctx.view;
 
         shadow.render(ctx, ctx_r);
+
+        if (ctx_r.cpu_culling)
+            cull_queue(ctx_r.queue, ctx_r.queue_bounds,
+                       make_frustum(ctx.view_proj), cull_masks, visible_queue);
+
         geometry.render({
             .size = ctx.size,
             .framebuf = ctx.g_buf.framebuffer,
@@ -69,11 +78,18 @@ void ProbeViewport::render(RenderContext &ctx_r)
             .view_proj_prev = ctx.view_proj_prev,
             .entity_vao = ctx_r.entity_vao,
             .sphere_mesh = ctx_r.mesh_instances[ctx_r.sphere_mesh_idx],
-            .entities = ctx_r.queue,
+            .entities = ctx_r.cpu_culling ? visible_queue : ctx_r.queue,
             .meshes = ctx_r.mesh_instances,
             .lights = ctx_r.lights,
+            .light_buf = ctx_r.light_buf,
         });
 
+        if (ctx_r.clustered_lights)
+        {
+            light_culling.render(ctx, ctx_r);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
         lighting.render(ctx, ctx_r);
         forward.render(ctx, ctx_r);
     }
@@ -4,6 +4,7 @@
 #include "renderer/context.hpp"
 #include "renderer/passes/forward.hpp"
 #include "renderer/passes/geometry.hpp"
+#include "renderer/passes/light_culling.hpp"
 #include "renderer/passes/lighting.hpp"
 #include "renderer/passes/shadow.hpp"
 #include "renderer/probe_buffer.hpp"
@@ -29,6 +30,9 @@ struct ProbeViewport
 
     glm::vec3 position;
 
+    std::vector<Entity> visible_queue;
+    std::vector<uint32_t> cull_masks;
+
     ViewportContext ctx{
         .size = glm::ivec2(64, 64),
         .near = 0.1f,
@@ -47,6 +51,11 @@ struct ProbeViewport
 
     GeometryPass geometry{};
 
+    LightCullingPass light_culling{{
+        .dims{8, 8, 16},
+        .max_cluster_lights = 64,
+    }};
+
     LightingPass lighting{{
         .cascade_count = shadow.params.cascade_count,
         .indirect_light = false,
@@ -65,6 +74,9 @@ struct ProbeViewport
 
     ProbeViewport();
 
+    // Call after Shader::resolve_pending, so programs submitted during
+    // construction compile in parallel.
+    void initialize();
     void render(RenderContext &ctx_r);
     void bake(RenderContext &ctx_r, const BakingJob &job, int bounce_idx,
               const ProbeGrid &grid, ProbeBuffer &buf);
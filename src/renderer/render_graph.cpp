@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <numeric>
+
+#include <Tracy.hpp>
+
+#include "logger.hpp"
+#include "profiler.hpp"
+#include "renderer/render_graph.hpp"
+
+using namespace engine;
+using namespace std;
+using namespace glm;
+
+static GLbitfield barrier_bit(Access access)
+{
+    switch (access)
+    {
+    case Access::sampled:
+        return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case Access::image:
+        return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case Access::attachment:
+        return GL_FRAMEBUFFER_BARRIER_BIT;
+    case Access::copy:
+        return GL_TEXTURE_UPDATE_BARRIER_BIT;
+    case Access::storage:
+        return GL_SHADER_STORAGE_BARRIER_BIT;
+    case Access::indirect:
+        return GL_COMMAND_BARRIER_BIT;
+    }
+
+    return GL_ALL_BARRIER_BITS;
+}
+
+// Writes through images and shader storage are not ordered with later
+// accesses without a barrier, rendering and copies are.
+static bool is_incoherent(Access access)
+{
+    return access == Access::image || access == Access::storage;
+}
+
+static uint64_t bytes_per_pixel(GLenum format)
+{
+    switch (format)
+    {
+    case GL_R8:
+        return 1;
+    case GL_RG8:
+    case GL_R16F:
+        return 2;
+    case GL_RGBA8:
+    case GL_RG16F:
+    case GL_R32F:
+    case GL_R11F_G11F_B10F:
+    case GL_DEPTH_COMPONENT32:
+    case GL_DEPTH_COMPONENT32F:
+        return 4;
+    case GL_RGBA16F:
+    case GL_RG32F:
+        return 8;
+    case GL_RGBA32F:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+static uint64_t texture_bytes(ivec2 size, GLenum format, int levels)
+{
+    uint64_t bytes = 0;
+
+    for (int level = 0; level < levels; level++)
+    {
+        bytes += static_cast<uint64_t>(size.x) * size.y;
+        size = max(size / 2, ivec2(1));
+    }
+
+    return bytes * bytes_per_pixel(format);
+}
+
+RenderGraph::~RenderGraph()
+{
+    for (auto &storage : storages)
+    {
+        for (const auto &view : storage.views)
+            glDeleteTextures(1, &view.id);
+
+        texture_pool.release(storage.id);
+    }
+}
+
+ResourceHandle RenderGraph::import(const char *name, uint id)
+{
+    resources.push_back({.name = name, .imported = true, .id = id});
+    return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+ResourceHandle RenderGraph::create_texture(const char *name,
+                                           const TextureDesc &desc)
+{
+    resources.push_back({.name = name, .imported = false, .desc = desc});
+    return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+void RenderGraph::add_pass(PassDesc pass) { passes.push_back(std::move(pass)); }
+
+uint RenderGraph::get_id(ResourceHandle handle) const
+{
+    return resources[handle].id;
+}
+
+// Walks backwards: a pass is live when enabled and something later reads one
+// of its outputs. Imported resources are always read after the frame.
+vector<bool> RenderGraph::cull() const
+{
+    vector<bool> live(passes.size(), false);
+    vector<bool> needed(resources.size(), false);
+
+    for (size_t i = 0; i < resources.size(); i++)
+        needed[i] = resources[i].imported;
+
+    for (size_t i = passes.size(); i-- > 0;)
+    {
+        const auto &pass = passes[i];
+
+        if (!pass.enabled)
+            continue;
+
+        live[i] = pass.side_effects ||
+                  ranges::any_of(pass.writes, [&needed](const auto &w)
+                                 { return needed[w.resource]; });
+
+        if (!live[i])
+            continue;
+
+        // Earlier contents of a transient only matter when read here.
+        for (const auto &w : pass.writes)
+            if (!resources[w.resource].imported)
+                needed[w.resource] = false;
+
+        for (const auto &r : pass.reads)
+            needed[r.resource] = true;
+    }
+
+    return live;
+}
+
+void RenderGraph::compute_lifetimes(const vector<bool> &live)
+{
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        if (!live[i])
+            continue;
+
+        const auto touch = [this, i](const ResourceAccess &a)
+        {
+            auto &r = resources[a.resource];
+            if (r.first == -1)
+                r.first = static_cast<int>(i);
+            r.last = static_cast<int>(i);
+        };
+
+        ranges::for_each(passes[i].reads, touch);
+        ranges::for_each(passes[i].writes, touch);
+    }
+}
+
+uint RenderGraph::view(Storage &storage, const TextureDesc &desc)
+{
+    for (const auto &v : storage.views)
+        if (v.levels == desc.levels && v.min_filter == desc.min_filter &&
+            v.mag_filter == desc.mag_filter)
+            return v.id;
+
+    // Views need a name that was never bound, glCreateTextures won't do.
+    uint id;
+    glGenTextures(1, &id);
+    glTextureView(id, GL_TEXTURE_2D, storage.id, storage.format, 0,
+                  desc.levels, 0, 1);
+    glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, desc.min_filter);
+    glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, desc.mag_filter);
+    glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    storage.views.push_back(
+        {desc.levels, desc.min_filter, desc.mag_filter, id});
+
+    return id;
+}
+
+// Transients with the most levels are placed first so smaller requests can
+// share their storage. Storage is shared by transients of the same size and
+// format whose pass ranges don't overlap.
+void RenderGraph::allocate()
+{
+    for (auto &storage : storages)
+        storage.intervals.clear();
+
+    vector<uint32_t> order;
+    for (uint32_t i = 0; i < resources.size(); i++)
+        if (!resources[i].imported && resources[i].first != -1)
+            order.push_back(i);
+
+    ranges::sort(order,
+                 [this](uint32_t a, uint32_t b)
+                 {
+                     const auto &ra = resources[a];
+                     const auto &rb = resources[b];
+                     return ra.desc.levels != rb.desc.levels
+                                ? ra.desc.levels > rb.desc.levels
+                                : ra.first < rb.first;
+                 });
+
+    for (const uint32_t idx : order)
+    {
+        auto &r = resources[idx];
+        const ivec2 interval{r.first, r.last};
+
+        const auto overlaps = [&interval](const Storage &s)
+        {
+            return ranges::any_of(s.intervals,
+                                  [&interval](const ivec2 &other)
+                                  {
+                                      return interval.x <= other.y &&
+                                             other.x <= interval.y;
+                                  });
+        };
+
+        uint32_t best = numeric_limits<uint32_t>::max();
+
+        for (uint32_t s = 0; s < storages.size(); s++)
+        {
+            const auto &storage = storages[s];
+
+            if (storage.size != r.desc.size ||
+                storage.format != r.desc.format ||
+                storage.levels < r.desc.levels || overlaps(storage))
+                continue;
+
+            if (best == numeric_limits<uint32_t>::max() ||
+                storage.levels < storages[best].levels)
+                best = s;
+        }
+
+        if (best == numeric_limits<uint32_t>::max())
+        {
+            Storage storage{
+                .size = r.desc.size,
+                .format = r.desc.format,
+                .levels = r.desc.levels,
+                .id = texture_pool.acquire(r.desc),
+            };
+
+            storages.push_back(std::move(storage));
+            best = static_cast<uint32_t>(storages.size() - 1);
+        }
+
+        auto &storage = storages[best];
+        storage.intervals.push_back(interval);
+        storage.last_used_frame = frame;
+
+        r.storage = best;
+        r.id = view(storage, r.desc);
+
+        stats.requested_bytes +=
+            texture_bytes(r.desc.size, r.desc.format, r.desc.levels);
+    }
+}
+
+// glMemoryBarrier applies to all resources, so one barrier covers every
+// pending write for the bits it issues.
+vector<GLbitfield> RenderGraph::place_barriers(const vector<bool> &live)
+{
+    const auto imported_key = [](const Resource &r)
+    { return pair<uint, string_view>(r.id, r.name); };
+
+    // Imported resources first, followed by transient storage.
+    vector<MemoryState> states(resources.size());
+    for (size_t h = 0; h < resources.size(); h++)
+    {
+        if (!resources[h].imported)
+            continue;
+
+        const auto it = imported_states.find(imported_key(resources[h]));
+        if (it != imported_states.end())
+            states[h] = it->second;
+    }
+
+    for (const auto &storage : storages)
+        states.push_back(storage.state);
+
+    const auto state = [this, &states](ResourceHandle handle) -> MemoryState &
+    {
+        const auto &r = resources[handle];
+        return r.imported ? states[handle]
+                          : states[resources.size() + r.storage];
+    };
+
+    vector<GLbitfield> barriers(passes.size(), 0);
+
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        if (!live[i])
+            continue;
+
+        const auto &pass = passes[i];
+
+        GLbitfield bits = 0;
+
+        const auto require = [&bits, &state](const ResourceAccess &a)
+        {
+            const auto &s = state(a.resource);
+            const GLbitfield bit = barrier_bit(a.access);
+
+            if (s.incoherent && !(s.visible & bit))
+                bits |= bit;
+        };
+
+        ranges::for_each(pass.reads, require);
+        ranges::for_each(pass.writes, require);
+
+        if (bits != 0)
+            for (auto &s : states)
+                if (s.incoherent)
+                    s.visible |= bits;
+
+        for (const auto &w : pass.writes)
+            state(w.resource) = {.incoherent = is_incoherent(w.access)};
+
+        barriers[i] = bits;
+    }
+
+    for (size_t h = 0; h < resources.size(); h++)
+    {
+        if (!resources[h].imported)
+            continue;
+
+        if (states[h].incoherent)
+            imported_states[imported_key(resources[h])] = states[h];
+        else
+            imported_states.erase(imported_key(resources[h]));
+    }
+
+    for (size_t s = 0; s < storages.size(); s++)
+        storages[s].state = states[resources.size() + s];
+
+    return barriers;
+}
+
+void RenderGraph::release_idle()
+{
+    erase_if(storages,
+             [this](Storage &storage)
+             {
+                 if (frame - storage.last_used_frame <= max_idle_frames)
+                     return false;
+
+                 for (const auto &view : storage.views)
+                     glDeleteTextures(1, &view.id);
+
+                 texture_pool.release(storage.id);
+
+                 return true;
+             });
+}
+
+void RenderGraph::execute()
+{
+    ZoneScoped;
+
+    stats = {};
+
+    const auto live = cull();
+    compute_lifetimes(live);
+    allocate();
+    const auto barriers = place_barriers(live);
+
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        if (!live[i])
+        {
+            if (passes[i].enabled)
+                stats.culled_pass_count++;
+
+            continue;
+        }
+
+        if (barriers[i] != 0)
+        {
+            glMemoryBarrier(barriers[i]);
+            stats.barrier_count++;
+        }
+
+        {
+            GpuZone _(passes[i].name);
+            passes[i].execute();
+        }
+        stats.pass_count++;
+    }
+
+    resources.clear();
+    passes.clear();
+
+    release_idle();
+
+    stats.storage_count = static_cast<uint32_t>(storages.size());
+    for (const auto &storage : storages)
+        stats.transient_bytes +=
+            texture_bytes(storage.size, storage.format, storage.levels);
+
+    frame++;
+}
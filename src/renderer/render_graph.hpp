@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "constants.hpp"
+#include "renderer/texture_pool.hpp"
+
+namespace engine
+{
+
+// How a pass touches a resource. Decides which barrier an earlier image or
+// shader storage write needs before the access.
+enum class Access
+{
+    sampled,
+    image,
+    // Rendering and blits.
+    attachment,
+    // glCopyImageSubData and mipmap generation.
+    copy,
+    storage,
+    indirect,
+};
+
+using ResourceHandle = uint32_t;
+
+struct ResourceAccess
+{
+    ResourceHandle resource;
+    Access access;
+};
+
+struct PassDesc
+{
+    const char *name = "";
+    bool enabled = true;
+    // Kept even when nothing reads its outputs, e.g., presenting.
+    bool side_effects = false;
+    std::vector<ResourceAccess> reads{};
+    std::vector<ResourceAccess> writes{};
+    std::function<void()> execute{};
+};
+
+// Rebuilt every frame: passes declare the resources they read and write, the
+// graph culls passes whose outputs are unused, places the memory barriers
+// between incoherent writes and later accesses, and backs transient textures
+// whose lifetimes don't overlap with the same storage.
+class RenderGraph
+{
+    struct Resource
+    {
+        const char *name;
+        bool imported;
+        TextureDesc desc{};
+        // Imported object, or the view of a transient once allocated.
+        uint id = invalid_texture_id;
+        // First and last live pass using the resource.
+        int first = -1;
+        int last = -1;
+        uint32_t storage = std::numeric_limits<uint32_t>::max();
+    };
+
+    // Whether the last write needs a barrier before other accesses, and which
+    // barrier bits were issued since.
+    struct MemoryState
+    {
+        bool incoherent = false;
+        GLbitfield visible = 0;
+    };
+
+    // Texture views give transients their own level count and sampler state
+    // on top of shared storage.
+    struct View
+    {
+        int levels;
+        GLenum min_filter;
+        GLenum mag_filter;
+        uint id;
+    };
+
+    struct Storage
+    {
+        glm::ivec2 size;
+        GLenum format;
+        int levels;
+        uint id;
+        std::vector<View> views{};
+        // Pass ranges of the current frame.
+        std::vector<glm::ivec2> intervals{};
+        // Kept across frames, transients only live for one.
+        MemoryState state{};
+        uint64_t last_used_frame = 0;
+    };
+
+    // Storage unused for this many frames goes back to the texture pool, e.g.,
+    // after resizing.
+    static constexpr uint64_t max_idle_frames = 60;
+
+    std::vector<Resource> resources;
+    std::vector<PassDesc> passes;
+    std::vector<Storage> storages;
+    // Imported objects outlive the frame, so does the state of their last
+    // write. Keyed by GL id and name, since buffer and texture ids overlap.
+    // Only incoherent states are kept.
+    std::map<std::pair<uint, std::string_view>, MemoryState> imported_states;
+    uint64_t frame = 0;
+
+    std::vector<bool> cull() const;
+    void compute_lifetimes(const std::vector<bool> &live);
+    void allocate();
+    std::vector<GLbitfield> place_barriers(const std::vector<bool> &live);
+    void release_idle();
+
+    static uint view(Storage &storage, const TextureDesc &desc);
+
+  public:
+    struct Stats
+    {
+        uint32_t pass_count = 0;
+        uint32_t culled_pass_count = 0;
+        uint32_t barrier_count = 0;
+        uint32_t storage_count = 0;
+        // Transient texture memory, and what it would take without aliasing.
+        uint64_t transient_bytes = 0;
+        uint64_t requested_bytes = 0;
+    };
+
+    Stats stats{};
+
+    RenderGraph() = default;
+    ~RenderGraph();
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    // Imported resources outlive the frame, so passes writing them are never
+    // culled.
+    ResourceHandle import(const char *name, uint id);
+    ResourceHandle create_texture(const char *name, const TextureDesc &desc);
+    void add_pass(PassDesc pass);
+
+    // Runs the live passes in order and clears the graph for the next frame.
+    void execute();
+
+    // Only valid while executing.
+    uint get_id(ResourceHandle handle) const;
+};
+
+} // namespace engine
@@ -3,6 +3,7 @@
 #include <array>
 #include <numeric>
 #include <string>
+#include <unordered_map>
 
 #include <glm/ext.hpp>
 #include <glm/gtx/string_cast.hpp>
@@ -17,6 +18,7 @@
 #include "profiler.hpp"
 #include "renderer.hpp"
 #include "renderer/passes/taa.hpp"
+#include "renderer/texture_pool.hpp"
 
 using namespace glm;
 using namespace std;
@@ -27,54 +29,66 @@ using std::filesystem::path;
 
 constexpr uint default_framebuffer = 0;
 
-static bool init_framebuffer(ivec2 size, uint hdr_frame_buf, uint &depth_tex,
-                             uint &hdr_tex, uint &hdr2_tex, uint &hdr_prev_tex)
+// The color attachment is a render graph transient, attached by the lighting
+// pass every frame. Depth comes from the texture pool, so resizing back to a
+// previous size reuses its storage.
+static bool init_framebuffer(ivec2 size, uint hdr_frame_buf, uint &depth_tex)
 {
-    glDeleteTextures(1, &hdr_tex);
-    glDeleteTextures(1, &hdr2_tex);
-    glDeleteTextures(1, &hdr_prev_tex);
-    glDeleteRenderbuffers(1, &depth_tex);
-
-    glCreateRenderbuffers(1, &depth_tex);
-    glNamedRenderbufferStorage(depth_tex, GL_DEPTH_COMPONENT32, size.x, size.y);
-
-    glCreateTextures(GL_TEXTURE_2D, 1, &hdr_tex);
-    glTextureStorage2D(hdr_tex, 1, GL_RGBA16F, size.x, size.y);
-    glTextureParameteri(hdr_tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTextureParameteri(hdr_tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTextureParameteri(hdr_tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(hdr_tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glCreateTextures(GL_TEXTURE_2D, 1, &hdr2_tex);
-    glTextureStorage2D(hdr2_tex, 1, GL_RGBA16F, size.x, size.y);
-    glTextureParameteri(hdr2_tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTextureParameteri(hdr2_tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTextureParameteri(hdr2_tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(hdr2_tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glCreateTextures(GL_TEXTURE_2D, 1, &hdr_prev_tex);
-    glTextureStorage2D(hdr_prev_tex, 5, GL_RGBA16F, size.x, size.y);
-    glTextureParameteri(hdr_prev_tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTextureParameteri(hdr_prev_tex, GL_TEXTURE_MIN_FILTER,
-                        GL_LINEAR_MIPMAP_LINEAR);
-    glTextureParameteri(hdr_prev_tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(hdr_prev_tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTextureParameteri(hdr_prev_tex, GL_TEXTURE_BASE_LEVEL, 0);
-    glTextureParameteri(hdr_prev_tex, GL_TEXTURE_MAX_LEVEL, 4);
-
-    glNamedFramebufferTexture(hdr_frame_buf, GL_COLOR_ATTACHMENT0, hdr_tex, 0);
-    glNamedFramebufferRenderbuffer(hdr_frame_buf, GL_DEPTH_ATTACHMENT,
-                                   GL_RENDERBUFFER, depth_tex);
+    texture_pool.release(depth_tex);
+
+    depth_tex = texture_pool.acquire({
+        .size = size,
+        .format = GL_DEPTH_COMPONENT32,
+        .min_filter = GL_NEAREST,
+        .mag_filter = GL_NEAREST,
+    });
+
+    glNamedFramebufferTexture(hdr_frame_buf, GL_DEPTH_ATTACHMENT, depth_tex, 0);
 
     return glCheckNamedFramebufferStatus(hdr_frame_buf, GL_FRAMEBUFFER) ==
            GL_FRAMEBUFFER_COMPLETE;
 }
 
+static bool init_ldr_target(ivec2 size, uint &ldr_frame_buf, uint &ldr_tex)
+{
+    texture_pool.release(ldr_tex);
+    ldr_tex = texture_pool.acquire({.size = size, .format = GL_RGBA8});
+
+    if (ldr_frame_buf == default_frame_buffer_id)
+        glCreateFramebuffers(1, &ldr_frame_buf);
+
+    glNamedFramebufferTexture(ldr_frame_buf, GL_COLOR_ATTACHMENT0, ldr_tex, 0);
+
+    return glCheckNamedFramebufferStatus(ldr_frame_buf, GL_FRAMEBUFFER) ==
+           GL_FRAMEBUFFER_COMPLETE;
+}
+
+// The history is kept at the output size, TAA upsamples into it.
+static void init_history(ivec2 size, uint &hdr_prev_tex)
+{
+    texture_pool.release(hdr_prev_tex);
+
+    hdr_prev_tex = texture_pool.acquire({
+        .size = size,
+        .format = GL_RGBA16F,
+        .levels = 5,
+        .min_filter = GL_LINEAR_MIPMAP_LINEAR,
+        .mag_filter = GL_LINEAR,
+    });
+
+    // Pooled storage may hold an older frame, don't let TAA resolve against
+    // it.
+    const vec4 clear_color{0.f};
+    for (int level = 0; level < 5; level++)
+        glClearTexImage(hdr_prev_tex, level, GL_RGBA, GL_FLOAT, &clear_color);
+}
+
 Renderer::Renderer(glm::ivec2 viewport_size, glm::vec3 camera_position,
                    glm::vec3 camera_look)
     : camera(camera_position, camera_look)
 {
     ctx_v.size = viewport_size;
+    ctx_v.render_size = viewport_size;
 
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
@@ -123,20 +137,6 @@ Renderer::Renderer(glm::ivec2 viewport_size, glm::vec3 camera_position,
                                    binding_tangents);
     }
 
-    // Point lights.
-    {
-        uint &tex = ctx_r.light_shadows_array;
-
-        glCreateTextures(GL_TEXTURE_CUBE_MAP_ARRAY, 1, &tex);
-
-        glTextureStorage3D(tex, 1, GL_DEPTH_COMPONENT32, 1024, 1024,
-                           ctx_r.lights.size() * 6);
-        glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTextureParameteri(tex, GL_TEXTURE_COMPARE_MODE,
-                            GL_COMPARE_REF_TO_TEXTURE);
-    }
-
     // Skybox stuff.
     {
         unsigned int buffer;
@@ -158,18 +158,26 @@ Renderer::Renderer(glm::ivec2 viewport_size, glm::vec3 camera_position,
 
     glCreateFramebuffers(1, &ctx_v.hdr_frame_buf);
 
-    if (!init_framebuffer(ctx_v.size, ctx_v.hdr_frame_buf, depth_tex,
-                          ctx_v.hdr_tex, ctx_v.hdr2_tex, ctx_v.history_tex))
+    if (!init_framebuffer(ctx_v.render_size, ctx_v.hdr_frame_buf, depth_tex))
         logger.error("Main viewport frame buffer incomplete.");
 
+    init_history(ctx_v.size, ctx_v.history_tex);
+
     // Setup state for displaying probe.
     GltfImporter importer{models_path / "sphere.gltf", *this};
     importer.import();
     ctx_r.sphere_mesh_idx = importer.models[0].mesh_index;
 
+    // Programs of all passes, including the probe viewport, were submitted
+    // during construction and compiled by the driver while importing.
+    Shader::resolve_pending();
+
+    probe_view.initialize();
+
     shadow.initialize(ctx_v);
     geometry.initialize(ctx_v);
     ssao.initialize(ctx_v);
+    light_culling.initialize(ctx_v);
     lighting.initialize(ctx_v);
     forward.initialize(ctx_v);
     volumetric.initialize(ctx_v);
@@ -343,7 +351,6 @@ variant<uint, Renderer::Error> Renderer::register_texture(const Texture &tex)
     return id;
 }
 
-// TODO: Do this dynamically.
 void Renderer::update_vao()
 {
     glVertexArrayElementBuffer(ctx_r.entity_vao, ctx_r.index_buf.get_id());
@@ -360,25 +367,147 @@ void Renderer::update_vao()
 
 size_t Renderer::register_mesh(const Mesh &mesh)
 {
+    return register_mesh(mesh.vertices, mesh.indices, mesh.bounds);
+}
+
+size_t Renderer::register_mesh(span<const Vertex> vertices,
+                               span<const uint32_t> indices,
+                               const optional<Aabb> &bounds)
+{
+    const uint vertex_buf_id = ctx_r.vertex_buf.get_id();
+    const uint index_buf_id = ctx_r.index_buf.get_id();
+
+    Aabb mesh_bounds{vec3(numeric_limits<float>::max()),
+                     vec3(numeric_limits<float>::lowest())};
+
+    if (bounds)
+    {
+        mesh_bounds = *bounds;
+    }
+    else
+    {
+        for (const auto &v : vertices)
+        {
+            mesh_bounds.min = glm::min(mesh_bounds.min, v.position);
+            mesh_bounds.max = glm::max(mesh_bounds.max, v.position);
+        }
+    }
+
     ctx_r.mesh_instances.emplace_back(
-        ctx_r.vertex_buf.allocate(mesh.vertices.data(),
-                                  mesh.vertices.size() * sizeof(Vertex)) /
+        ctx_r.vertex_buf.allocate(vertices.data(), vertices.size_bytes()) /
             sizeof(Vertex),
-        ctx_r.index_buf.allocate(mesh.indices.data(),
-                                 mesh.indices.size() * sizeof(uint32_t)),
-        static_cast<int>(mesh.indices.size()));
+        ctx_r.index_buf.allocate(indices.data(), indices.size_bytes()),
+        static_cast<int>(indices.size()), mesh_bounds, true);
+
+    // Growing replaces the underlying buffers.
+    if (vertex_buf_id != ctx_r.vertex_buf.get_id() ||
+        index_buf_id != ctx_r.index_buf.get_id())
+        update_vao();
 
     return ctx_r.mesh_instances.size() - 1;
 }
 
+void Renderer::unregister_mesh(size_t mesh_idx)
+{
+    auto &m = ctx_r.mesh_instances[mesh_idx];
+
+    if (!m.registered)
+        return;
+
+    ctx_r.vertex_buf.free(m.vertex_offset * sizeof(Vertex));
+    ctx_r.index_buf.free(static_cast<uint32_t>(m.index_offset_bytes));
+
+    m = MeshInstance{};
+}
+
+void Renderer::defragment_meshes()
+{
+    ZoneScoped;
+
+    unordered_map<uint32_t, uint32_t> vertex_map, index_map;
+
+    for (const auto &r : ctx_r.vertex_buf.defragment())
+        vertex_map.emplace(r.old_offset, r.new_offset);
+    for (const auto &r : ctx_r.index_buf.defragment())
+        index_map.emplace(r.old_offset, r.new_offset);
+
+    for (auto &m : ctx_r.mesh_instances)
+    {
+        // Unregistered meshes own no ranges.
+        if (!m.registered)
+            continue;
+
+        if (auto it = vertex_map.find(m.vertex_offset * sizeof(Vertex));
+            it != vertex_map.end())
+            m.vertex_offset = it->second / sizeof(Vertex);
+
+        if (auto it = index_map.find(m.index_offset_bytes);
+            it != index_map.end())
+            m.index_offset_bytes = it->second;
+    }
+
+    update_vao();
+}
+
+void Renderer::update_light_buffer()
+{
+    ZoneScoped;
+
+    light_data.clear();
+
+    for (const auto &l : ctx_r.lights)
+    {
+        const float radius_squared = l.radius_squared(0.01f);
+
+        light_data.push_back(PointLightData{
+            .position = l.position,
+            .radius = sqrt(radius_squared),
+            .color = l.intensity * l.color,
+            .radius_squared = radius_squared,
+        });
+    }
+
+    if (light_data.size() > light_capacity)
+    {
+        light_capacity =
+            std::max<uint32_t>(light_data.size(), 2 * light_capacity);
+
+        glDeleteBuffers(1, &ctx_r.light_buf);
+        glCreateBuffers(1, &ctx_r.light_buf);
+        glNamedBufferStorage(ctx_r.light_buf,
+                             light_capacity * sizeof(PointLightData), nullptr,
+                             GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    if (!light_data.empty())
+        glNamedBufferSubData(ctx_r.light_buf, 0,
+                             light_data.size() * sizeof(PointLightData),
+                             light_data.data());
+}
+
 void Renderer::render(float dt, std::vector<Entity> queue)
 {
-    GpuZone _(10);
+    GpuZone _("Frame");
 
     ZoneScoped;
 
     const uint32_t jitter_sample_count = 8;
 
+    // Only TAA can reconstruct the output from a smaller render, the other
+    // passes assume all inputs share a size.
+    const auto frame_time =
+        profiler_zone_stats("Frame", DynamicResolution::sample_count);
+    const ivec2 render_size =
+        taa.enabled && frame_time
+            ? dynamic_resolution.update(ctx_v.size, frame_time->mean)
+            : ctx_v.size;
+
+    if (render_size != ctx_v.render_size)
+    {
+        ctx_v.render_size = render_size;
+        resize_render_targets();
+    }
+
     // TODO: throw this in a UBO
     ctx_v.proj = perspective(ctx_v.fov,
                              static_cast<float>(ctx_v.size.x) /
@@ -393,7 +522,7 @@ void Renderer::render(float dt, std::vector<Entity> queue)
         auto jitter_idx = frame_idx + 1u % taa.params.jitter_sample_count;
         const vec2 jitter = vec2(2.f * halton(jitter_idx + 1, 2) - 1.f,
                                  2.f * halton(jitter_idx + 1, 3) - 1.f) /
-                            static_cast<vec2>(ctx_v.size);
+                            static_cast<vec2>(ctx_v.render_size);
 
         ctx_v.proj[2][0] += jitter.x;
         ctx_v.proj[2][1] += jitter.y;
@@ -407,129 +536,331 @@ void Renderer::render(float dt, std::vector<Entity> queue)
     ctx_r.queue = std::move(queue);
     ctx_r.dt = dt;
 
-    if (baking_jobs.size() > 0)
-    {
-        TracyGpuZone("Probe baking pass");
-        GpuZone _(0);
-        bake();
-    }
-
-    {
-        TracyGpuZone("Shadow pass");
-        GpuZone _(1);
-        shadow.render(ctx_v, ctx_r);
-    }
-
-    {
-        TracyGpuZone("Geometry pass");
-        GpuZone _(2);
-        geometry.render({
-            .size = ctx_v.size,
-            .framebuf = ctx_v.g_buf.framebuffer,
-            .view = ctx_v.view,
-            .view_proj = ctx_v.view_proj,
-            .view_proj_prev = ctx_v.view_proj_prev,
-            .entity_vao = ctx_r.entity_vao,
-            .sphere_mesh = ctx_r.mesh_instances[ctx_r.sphere_mesh_idx],
-            .entities = ctx_r.queue,
-            .meshes = ctx_r.mesh_instances,
-            .lights = ctx_r.lights,
-            .jitter = jitter,
-            .jitter_prev = jitter_prev,
-        });
-    }
-
-    if (ssao.enabled)
     {
-        TracyGpuZone("SSAO pass");
-        GpuZone _(3);
-        ssao.render(ctx_v);
-    }
+        ZoneScopedN("Queue bounds");
 
-    if (ssr.enabled)
-    {
-        TracyGpuZone("SSR pass");
-        GpuZone _(6);
-        ssr.render(ctx_v, ctx_r);
+        ctx_r.queue_bounds.clear();
+        for (const auto &e : ctx_r.queue)
+            ctx_r.queue_bounds.push_back(transform_aabb(
+                ctx_r.mesh_instances[e.mesh_index].bounds, e.model));
     }
 
-    {
-        TracyGpuZone("Lighting pass");
-        GpuZone _(4);
-        lighting.render(ctx_v, ctx_r);
-    }
+    update_light_buffer();
 
+    if (baking_jobs.size() > 0)
     {
-        TracyGpuZone("Forward pass");
-        GpuZone _(5);
-        forward.render(ctx_v, ctx_r);
+        TracyGpuZone("Probe baking pass");
+        GpuZone _("Probe baking");
+        bake();
     }
 
-    uint source_tex = ctx_v.hdr_tex;
-    uint target_tex = ctx_v.hdr2_tex;
+    if (ctx_r.cpu_culling)
+        cull_queue(ctx_r.queue, ctx_r.queue_bounds,
+                   make_frustum(ctx_v.view_proj), cull_masks, visible_queue);
+
+    auto &g = graph;
+
+    const auto shadow_map = g.import("Shadow map", ctx_v.shadow_map);
+    const auto point_shadows =
+        g.import("Point light shadows", ctx_r.light_shadow_atlas);
+    const auto depth = g.import("Depth", ctx_v.g_buf.depth);
+    const auto normal_metallic =
+        g.import("Normal metallic", ctx_v.g_buf.normal_metallic);
+    const auto base_color_roughness =
+        g.import("Base color roughness", ctx_v.g_buf.base_color_roughness);
+    const auto velocity = g.import("Velocity", ctx_v.g_buf.velocity);
+    const auto ao = g.import("AO", ctx_v.ao_tex);
+    const auto reflections = g.import("Reflections", ctx_v.reflections_tex);
+    const auto history = g.import("History", ctx_v.history_tex);
+    const auto clusters = g.import("Light clusters", ctx_v.light_clusters);
+    const auto cluster_indices =
+        g.import("Light cluster indices", ctx_v.light_cluster_indices);
+
+    const TextureDesc color_desc{.size = ctx_v.size, .format = GL_RGBA16F};
+
+    // Post-processing passes write a new color target each, aliasing replaces
+    // the ping-pong between two textures.
+    auto color = g.create_texture(
+        "HDR", {.size = ctx_v.render_size, .format = GL_RGBA16F});
+
+    g.add_pass({
+        .name = "Shadow",
+        .writes = {{shadow_map, Access::attachment},
+                   {point_shadows, Access::attachment}},
+        .execute =
+            [&]
+        {
+            TracyGpuZone("Shadow pass");
+            shadow.render(ctx_v, ctx_r);
+        },
+    });
+
+    g.add_pass({
+        .name = "Geometry",
+        .writes = {{depth, Access::attachment},
+                   {normal_metallic, Access::attachment},
+                   {base_color_roughness, Access::attachment},
+                   {velocity, Access::attachment}},
+        .execute =
+            [&, jitter]
+        {
+            TracyGpuZone("Geometry pass");
+            geometry.render({
+                .size = ctx_v.render_size,
+                .framebuf = ctx_v.g_buf.framebuffer,
+                .view = ctx_v.view,
+                .view_proj = ctx_v.view_proj,
+                .view_proj_prev = ctx_v.view_proj_prev,
+                .entity_vao = ctx_r.entity_vao,
+                .sphere_mesh = ctx_r.mesh_instances[ctx_r.sphere_mesh_idx],
+                .entities = ctx_r.cpu_culling ? visible_queue : ctx_r.queue,
+                .meshes = ctx_r.mesh_instances,
+                .lights = ctx_r.lights,
+                .light_buf = ctx_r.light_buf,
+                .jitter = jitter,
+                .jitter_prev = jitter_prev,
+                .indirect = ctx_r.indirect_draws,
+                .cull = ctx_r.gpu_culling,
+            });
+        },
+    });
+
+    g.add_pass({
+        .name = "SSAO",
+        .enabled = ssao.enabled,
+        .reads = {{depth, Access::sampled},
+                  {normal_metallic, Access::sampled}},
+        .writes = {{ao, Access::attachment}},
+        .execute =
+            [&]
+        {
+            TracyGpuZone("SSAO pass");
+            ssao.render(ctx_v);
+        },
+    });
+
+    g.add_pass({
+        .name = "SSR",
+        .enabled = ssr.enabled,
+        .reads = {{depth, Access::sampled},
+                  {normal_metallic, Access::sampled},
+                  {base_color_roughness, Access::sampled}},
+        .writes = {{reflections, Access::attachment}},
+        .execute =
+            [&]
+        {
+            TracyGpuZone("SSR pass");
+            ssr.render(ctx_v, ctx_r);
+        },
+    });
+
+    g.add_pass({
+        .name = "Light culling",
+        .enabled = ctx_r.clustered_lights,
+        .writes = {{clusters, Access::storage},
+                   {cluster_indices, Access::storage}},
+        .execute =
+            [&]
+        {
+            TracyGpuZone("Light culling pass");
+            light_culling.render(ctx_v, ctx_r);
+        },
+    });
+
+    g.add_pass({
+        .name = "Lighting",
+        .reads = {{depth, Access::sampled},
+                  {normal_metallic, Access::sampled},
+                  {base_color_roughness, Access::sampled},
+                  {velocity, Access::sampled},
+                  {shadow_map, Access::sampled},
+                  {point_shadows, Access::sampled},
+                  {ao, Access::sampled},
+                  {reflections, Access::sampled},
+                  {history, Access::sampled},
+                  {clusters, Access::storage},
+                  {cluster_indices, Access::storage}},
+        .writes = {{color, Access::attachment}},
+        .execute =
+            [&, color]
+        {
+            TracyGpuZone("Lighting pass");
+            glNamedFramebufferTexture(ctx_v.hdr_frame_buf, GL_COLOR_ATTACHMENT0,
+                                      g.get_id(color), 0);
+            lighting.render(ctx_v, ctx_r);
+        },
+    });
+
+    g.add_pass({
+        .name = "Forward",
+        .reads = {{color, Access::attachment}, {depth, Access::attachment}},
+        .writes = {{color, Access::attachment}},
+        .execute =
+            [&]
+        {
+            TracyGpuZone("Forward pass");
+            forward.render(ctx_v, ctx_r);
+        },
+    });
 
     if (taa.enabled)
     {
-        taa.render({
-            .proj = ctx_v.proj,
-            .proj_inv = ctx_v.proj_inv,
-            .size = ctx_v.size,
-            .source_tex = source_tex,
-            .target_tex = target_tex,
-            .history_tex = ctx_v.history_tex,
-            .velocity_tex = ctx_v.g_buf.velocity,
-            .depth_tex = ctx_v.g_buf.depth,
+        const auto resolved = g.create_texture("TAA", color_desc);
+
+        g.add_pass({
+            .name = "TAA",
+            .reads = {{color, Access::sampled},
+                      {depth, Access::sampled},
+                      {velocity, Access::sampled},
+                      {history, Access::sampled}},
+            .writes = {{resolved, Access::image}},
+            .execute =
+                [&, color, resolved]
+            {
+                taa.render({
+                    .proj = ctx_v.proj,
+                    .proj_inv = ctx_v.proj_inv,
+                    .size = ctx_v.size,
+                    .source_size = ctx_v.render_size,
+                    .source_tex = g.get_id(color),
+                    .target_tex = g.get_id(resolved),
+                    .history_tex = ctx_v.history_tex,
+                    .velocity_tex = ctx_v.g_buf.velocity,
+                    .depth_tex = ctx_v.g_buf.depth,
+                });
+            },
         });
 
-        swap(target_tex, source_tex);
+        color = resolved;
     }
 
-    glCopyImageSubData(source_tex, GL_TEXTURE_2D, 0, 0, 0, 0, ctx_v.history_tex,
-                       GL_TEXTURE_2D, 0, 0, 0, 0, ctx_v.size.x, ctx_v.size.y,
-                       1);
-    glGenerateTextureMipmap(ctx_v.history_tex);
+    g.add_pass({
+        .name = "History",
+        .reads = {{color, Access::copy}},
+        .writes = {{history, Access::copy}},
+        .execute =
+            [&, color]
+        {
+            glCopyImageSubData(g.get_id(color), GL_TEXTURE_2D, 0, 0, 0, 0,
+                               ctx_v.history_tex, GL_TEXTURE_2D, 0, 0, 0, 0,
+                               ctx_v.size.x, ctx_v.size.y, 1);
+            glGenerateTextureMipmap(ctx_v.history_tex);
+        },
+    });
 
     // TODO: do after tone mapping
     if (sharpen.enabled)
     {
-        sharpen.render({
-            .size = ctx_v.size,
-            .source_tex = source_tex,
-            .target_tex = target_tex,
+        const auto sharpened = g.create_texture("Sharpen", color_desc);
+
+        g.add_pass({
+            .name = "Sharpen",
+            .reads = {{color, Access::sampled}},
+            .writes = {{sharpened, Access::image}},
+            .execute =
+                [&, color, sharpened]
+            {
+                sharpen.render({
+                    .size = ctx_v.size,
+                    .source_tex = g.get_id(color),
+                    .target_tex = g.get_id(sharpened),
+                });
+            },
         });
 
-        swap(target_tex, source_tex);
+        color = sharpened;
     }
 
     if (volumetric.enabled)
     {
-        GpuZone _(11);
-        TracyGpuZone("Volumetric pass");
-        volumetric.render(ctx_v, ctx_r, source_tex);
+        const auto scatter = g.create_texture(
+            "Volumetric scatter", volumetric.scatter_desc(ctx_v.size));
+        const auto blur = g.create_texture(
+            "Volumetric blur", volumetric.scatter_desc(ctx_v.size));
+
+        g.add_pass({
+            .name = "Volumetric",
+            .reads = {{color, Access::image},
+                      {depth, Access::sampled},
+                      {shadow_map, Access::sampled},
+                      {point_shadows, Access::sampled},
+                      {clusters, Access::storage},
+                      {cluster_indices, Access::storage}},
+            .writes = {{color, Access::image},
+                       {scatter, Access::image},
+                       {blur, Access::image}},
+            .execute =
+                [&, color, scatter, blur]
+            {
+                TracyGpuZone("Volumetric pass");
+                volumetric.render(ctx_v, ctx_r, g.get_id(color),
+                                  g.get_id(scatter), g.get_id(blur));
+            },
+        });
     }
 
     if (motion_blur.enabled)
     {
-        TracyGpuZone("Motion blur pass");
-        GpuZone _(7);
-        motion_blur.render(ctx_v, ctx_r, source_tex, target_tex);
-        swap(target_tex, source_tex);
+        const auto blurred = g.create_texture("Motion blur", color_desc);
+
+        g.add_pass({
+            .name = "Motion blur",
+            .reads = {{color, Access::sampled}, {velocity, Access::sampled}},
+            .writes = {{blurred, Access::image}},
+            .execute =
+                [&, color, blurred]
+            {
+                TracyGpuZone("Motion blur pass");
+                motion_blur.render(ctx_v, ctx_r, g.get_id(color),
+                                   g.get_id(blurred));
+            },
+        });
+
+        color = blurred;
     }
 
     if (bloom.enabled)
     {
-        GpuZone _(8);
-        TracyGpuZone("Bloom pass");
-        bloom.render(ctx_v, ctx_r, source_tex, target_tex);
-        swap(target_tex, source_tex);
-    }
+        const auto composite = g.create_texture("Bloom", color_desc);
+        const auto downsample = g.create_texture(
+            "Bloom downsample", bloom.downsample_desc(ctx_v.size));
+        const auto upsample = g.create_texture(
+            "Bloom upsample", bloom.upsample_desc(ctx_v.size));
+
+        g.add_pass({
+            .name = "Bloom",
+            .reads = {{color, Access::sampled}},
+            .writes = {{composite, Access::image},
+                       {downsample, Access::image},
+                       {upsample, Access::image}},
+            .execute =
+                [&, color, composite, downsample, upsample]
+            {
+                TracyGpuZone("Bloom pass");
+                bloom.render(ctx_v, ctx_r, g.get_id(color),
+                             g.get_id(composite), g.get_id(downsample),
+                             g.get_id(upsample));
+            },
+        });
 
-    {
-        GpuZone _(9);
-        TracyGpuZone("Tone map pass");
-        tone_map.render(ctx_v, ctx_r, source_tex);
+        color = composite;
     }
 
+    g.add_pass({
+        .name = "Tone map",
+        .side_effects = true,
+        .reads = {{color, Access::sampled}},
+        .execute =
+            [&, color]
+        {
+            TracyGpuZone("Tone map pass");
+            tone_map.render(ctx_v, ctx_r, g.get_id(color));
+        },
+    });
+
+    g.execute();
+    texture_pool.collect();
+
     jitter_prev = jitter;
     ctx_v.view_proj_prev = ctx_v.view_proj;
 
@@ -540,14 +871,42 @@ void Renderer::resize_viewport(glm::vec2 size)
 {
     ctx_v.size = size;
 
-    init_framebuffer(size, ctx_v.hdr_frame_buf, depth_tex, ctx_v.hdr_tex,
-                     ctx_v.hdr2_tex, ctx_v.history_tex);
+    // Targets at the render size follow in the next render, once the render
+    // size for the new output size is known.
+    init_history(ctx_v.size, ctx_v.history_tex);
+
+    if (ldr_tex != invalid_texture_id)
+        init_ldr_target(ctx_v.size, ctx_v.ldr_frame_buf, ldr_tex);
+}
+
+void Renderer::enable_offscreen_target()
+{
+    if (!init_ldr_target(ctx_v.size, ctx_v.ldr_frame_buf, ldr_tex))
+        logger.error("Offscreen frame buffer incomplete.");
+}
+
+std::vector<uint8_t> Renderer::read_ldr_pixels()
+{
+    std::vector<uint8_t> pixels(4 * ctx_v.size.x * ctx_v.size.y);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, ctx_v.ldr_frame_buf);
+    if (ctx_v.ldr_frame_buf != default_frame_buffer_id)
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, ctx_v.size.x, ctx_v.size.y, GL_RGBA, GL_UNSIGNED_BYTE,
+                 pixels.data());
+
+    return pixels;
+}
+
+void Renderer::resize_render_targets()
+{
+    init_framebuffer(ctx_v.render_size, ctx_v.hdr_frame_buf, depth_tex);
 
     geometry.initialize(ctx_v);
     ssao.initialize(ctx_v);
     ssr.initialize(ctx_v);
-    bloom.initialize(ctx_v);
-    volumetric.initialize(ctx_v);
 }
 
 void Renderer::prepare_bake(glm::vec3 center, glm::vec3 world_dims,
@@ -668,7 +1027,11 @@ uint32_t Renderer::id_at_screen_coords(const glm::ivec2 &pos)
     glBindFramebuffer(GL_FRAMEBUFFER, ctx_v.g_buf.framebuffer);
     glReadBuffer(GL_COLOR_ATTACHMENT0 + 3);
 
-    glReadPixels(pos.x, ctx_v.size.y - pos.y, 1, 1, GL_RED_INTEGER,
-                 GL_UNSIGNED_INT, &id);
+    // The ids are rendered at the render size.
+    const ivec2 render_pos =
+        ivec2(vec2(pos) * vec2(ctx_v.render_size) / vec2(ctx_v.size));
+
+    glReadPixels(render_pos.x, ctx_v.render_size.y - render_pos.y, 1, 1,
+                 GL_RED_INTEGER, GL_UNSIGNED_INT, &id);
     return id;
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <optional>
+#include <span>
 #include <variant>
 #include <vector>
 
@@ -11,10 +13,13 @@
 #include "constants.hpp"
 #include "context.hpp"
 #include "entity.hpp"
+#include "profiler.hpp"
 #include "renderer/buffer.hpp"
+#include "renderer/dynamic_resolution.hpp"
 #include "renderer/passes/bloom.hpp"
 #include "renderer/passes/forward.hpp"
 #include "renderer/passes/geometry.hpp"
+#include "renderer/passes/light_culling.hpp"
 #include "renderer/passes/lighting.hpp"
 #include "renderer/passes/motion_blur.hpp"
 #include "renderer/passes/shadow.hpp"
@@ -25,6 +30,7 @@
 #include "renderer/passes/tone_map.hpp"
 #include "renderer/passes/volumetric.hpp"
 #include "renderer/probe_viewport.hpp"
+#include "renderer/render_graph.hpp"
 
 namespace engine
 {
@@ -37,6 +43,8 @@ class Renderer
     };
 
     uint depth_tex = invalid_texture_id;
+    // Tone mapped result when rendering offscreen.
+    uint ldr_tex = invalid_texture_id;
 
     ProbeViewport probe_view;
     ProbeGrid probe_grid;
@@ -47,7 +55,15 @@ class Renderer
     uint64_t frame_idx = 0;
     glm::vec2 jitter_prev;
 
+    std::vector<Entity> visible_queue;
+    std::vector<uint32_t> cull_masks;
+
+    std::vector<PointLightData> light_data;
+    uint32_t light_capacity = 0;
+
     void bake();
+    void update_light_buffer();
+    void resize_render_targets();
 
   public:
     int bake_batch_size = 32;
@@ -55,6 +71,8 @@ class Renderer
 
     Camera camera;
 
+    RenderGraph graph;
+
     ViewportContext ctx_v{
         .near = 0.1f,
         .far = 50.f,
@@ -73,8 +91,8 @@ class Renderer
             Light{glm::vec3{5, 0, 0}, glm::vec3{0., 1., 1.}, 0.f},
         },
         .sh_texs = std::span<uint, 7>{probe_buf.front(), 7},
-        .vertex_buf{32'000 * sizeof(Vertex), 0},
-        .index_buf{32'000 * sizeof(uint32_t), 0},
+        .vertex_buf{32'000 * sizeof(Vertex), sizeof(Vertex)},
+        .index_buf{32'000 * sizeof(uint32_t), sizeof(uint32_t)},
     };
 
     ShadowPass shadow{{
@@ -88,6 +106,11 @@ class Renderer
 
     GeometryPass geometry{};
 
+    LightCullingPass light_culling{{
+        .dims{16, 9, 24},
+        .max_cluster_lights = 256,
+    }};
+
     SsaoPass ssao{{
         .kernel_size = 64,
         .sample_count = 64,
@@ -127,6 +150,13 @@ class Renderer
         .filter = TaaPass::Filter::blackman_harris,
     }};
 
+    DynamicResolution dynamic_resolution{{
+        .target_ms = 16.6f,
+        .min_scale = 0.5f,
+        .step = 0.05f,
+        .tolerance = 0.1f,
+    }};
+
     SharpenPass sharpen{};
 
     VolumetricPass volumetric{{
@@ -173,11 +203,37 @@ class Renderer
 
     void update_vao();
     size_t register_mesh(const Mesh &mesh);
-    inline static void render_mesh_instance(const MeshInstance &m)
+    size_t register_mesh(std::span<const Vertex> vertices,
+                         std::span<const uint32_t> indices,
+                         const std::optional<Aabb> &bounds = std::nullopt);
+    // Releases the mesh's vertex and index ranges. The index stays reserved
+    // so existing entities keep referring to the right meshes, but the mesh
+    // must not be drawn anymore.
+    void unregister_mesh(size_t mesh_idx);
+    // Compacts the vertex and index buffers and updates all mesh instances.
+    void defragment_meshes();
+    // The base instance is visible to shaders as gl_BaseInstance, which
+    // passes use to index per-draw data.
+    inline static void render_mesh_instance(const MeshInstance &m,
+                                            uint32_t base_instance = 0)
     {
-        glDrawElementsBaseVertex(
+        glDrawElementsInstancedBaseVertexBaseInstance(
             GL_TRIANGLES, m.primitive_count, GL_UNSIGNED_INT,
-            (void *)(m.index_offset_bytes), m.vertex_offset);
+            (void *)(m.index_offset_bytes), 1, m.vertex_offset,
+            base_instance);
+        profiler_count_draws(1, m.primitive_count / 3);
+    }
+    // Draws instance_count copies of the mesh, shaders tell them apart by
+    // gl_InstanceID.
+    inline static void render_mesh_instances(const MeshInstance &m,
+                                             uint32_t instance_count)
+    {
+        glDrawElementsInstancedBaseVertexBaseInstance(
+            GL_TRIANGLES, m.primitive_count, GL_UNSIGNED_INT,
+            (void *)(m.index_offset_bytes), instance_count, m.vertex_offset,
+            0);
+        profiler_count_draws(1, static_cast<uint64_t>(instance_count) *
+                                    (m.primitive_count / 3));
     }
 
     void prepare_bake(glm::vec3 center, glm::vec3 world_dims, float distance,
@@ -185,6 +241,12 @@ class Renderer
 
     void resize_viewport(glm::vec2 size);
 
+    // Tone maps into a texture instead of the default framebuffer, for
+    // contexts that don't have one.
+    void enable_offscreen_target();
+    // Tone mapped image of the last frame as RGBA8, rows from bottom to top.
+    std::vector<uint8_t> read_ldr_pixels();
+
     std::variant<uint, Error> register_texture(const Texture &texture);
     std::variant<uint, Error>
     register_texture(const CompressedTexture &texture);
@@ -0,0 +1,82 @@
+#include <algorithm>
+
+#include <Tracy.hpp>
+
+#include "renderer/texture_pool.hpp"
+
+using namespace engine;
+using namespace std;
+
+TexturePool engine::texture_pool{};
+
+uint TexturePool::acquire(const TextureDesc &desc)
+{
+    auto it = ranges::find_if(entries,
+                              [&desc](const Entry &e)
+                              {
+                                  return !e.in_use && e.size == desc.size &&
+                                         e.format == desc.format &&
+                                         e.levels == desc.levels;
+                              });
+
+    if (it == entries.end())
+    {
+        ZoneScopedN("Allocate pooled texture");
+
+        Entry entry{
+            .size = desc.size,
+            .format = desc.format,
+            .levels = desc.levels,
+        };
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &entry.id);
+        glTextureStorage2D(entry.id, desc.levels, desc.format, desc.size.x,
+                           desc.size.y);
+
+        entries.push_back(entry);
+        it = entries.end() - 1;
+    }
+
+    it->in_use = true;
+
+    glTextureParameteri(it->id, GL_TEXTURE_MIN_FILTER, desc.min_filter);
+    glTextureParameteri(it->id, GL_TEXTURE_MAG_FILTER, desc.mag_filter);
+    glTextureParameteri(it->id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(it->id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(it->id, GL_TEXTURE_BASE_LEVEL, 0);
+    glTextureParameteri(it->id, GL_TEXTURE_MAX_LEVEL, desc.levels - 1);
+
+    return it->id;
+}
+
+void TexturePool::release(uint id)
+{
+    if (id == invalid_texture_id)
+        return;
+
+    const auto it =
+        ranges::find_if(entries, [id](const Entry &e) { return e.id == id; });
+
+    if (it == entries.end())
+        return;
+
+    it->in_use = false;
+    it->released_frame = frame;
+}
+
+void TexturePool::collect()
+{
+    erase_if(entries,
+             [this](const Entry &e)
+             {
+                 if (e.in_use || frame - e.released_frame <= max_idle_frames)
+                     return false;
+
+                 glDeleteTextures(1, &e.id);
+                 return true;
+             });
+
+    frame++;
+}
+
+size_t TexturePool::texture_count() const { return entries.size(); }
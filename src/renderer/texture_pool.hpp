@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "constants.hpp"
+
+namespace engine
+{
+
+struct TextureDesc
+{
+    glm::ivec2 size{0};
+    GLenum format = GL_RGBA16F;
+    int levels = 1;
+    GLenum min_filter = GL_LINEAR;
+    GLenum mag_filter = GL_LINEAR;
+};
+
+// Render targets keyed by size, format and level count. Released textures
+// stay around for a while, so resizing the viewport back and forth or
+// switching the render resolution is a lookup instead of a reallocation.
+class TexturePool
+{
+    struct Entry
+    {
+        glm::ivec2 size;
+        GLenum format;
+        int levels;
+        uint id;
+        bool in_use;
+        uint64_t released_frame;
+    };
+
+    // Released textures unused for this many frames are deleted.
+    static constexpr uint64_t max_idle_frames = 120;
+
+    std::vector<Entry> entries;
+    uint64_t frame = 0;
+
+  public:
+    // Sampler state is reset from the description, contents are undefined.
+    uint acquire(const TextureDesc &desc);
+    // Ignores invalid ids.
+    void release(uint id);
+    // Call once per frame.
+    void collect();
+
+    size_t texture_count() const;
+};
+
+extern TexturePool texture_pool;
+
+} // namespace engine
@@ -1,15 +1,20 @@
 #define STB_IMAGE_IMPLEMENTATION
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdlib>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <optional>
-#include <regex>
 #include <string_view>
 #include <utility>
 #include <variant>
+#include <vector>
 
+#include <Tracy.hpp>
+#include <fmt/format.h>
 #include <glad/glad.h>
 #include <glm/ext.hpp>
 #include <glm/glm.hpp>
@@ -26,308 +31,590 @@ using std::filesystem::path;
 using namespace engine;
 using namespace std;
 
-// https://community.khronos.org/t/include-in-glsl/59203/6
-static std::string process_includes(const std::string &source,
-                                    const path &filename, int level)
+optional<Shader::StageSource> Shader::load_stage(const StageDesc &desc)
 {
-    if (level > 16)
-        logger.error("Cyclic includes");
+    if (!std::filesystem::exists(desc.path))
+    {
+        logger.error("Shader not found at path: {}", desc.path.string());
+        return nullopt;
+    }
 
-    regex re("^[ ]*#[ ]*include[ ]+[\"<](.*)[\">].*");
+    return StageSource{desc,
+                       preprocessor.process(utils::from_file(desc.path),
+                                            desc.path, desc.defines)};
+}
 
-    stringstream input;
-    stringstream output;
-    input << source;
+// Status is checked in resolve so the driver can compile in the background.
+uint Shader::compile_shader_stage(const StageSource &s)
+{
+    uint shader = glCreateShader(s.desc.stage);
 
-    size_t line_number = 1;
-    smatch matches;
+    auto c_str = s.source.source.c_str();
 
-    string line;
-    while (std::getline(input, line))
-    {
-        if (regex_search(line, matches, re))
-        {
-            std::string include_file = matches[1];
-            std::string include_string;
-
-            auto path = shaders_path;
-            path.concat(include_file);
-
-            if (filesystem::exists(path))
-            {
-                include_string = utils::from_file(path);
-            }
-            else
-            {
-                logger.error("Cannot open include file: {}", include_file);
-            }
-
-            output << process_includes(include_string, include_file, level + 1)
-                   << endl;
-        }
-        else
-        {
-            // if (line_number != 1)
-            //     output << fmt::format("#line {} \"{}\"\n{}", line_number,
-            //                           filename.string(), line)
-            //            << endl;
-            // else
-            output << line << endl;
-        }
+    glShaderSource(shader, 1, &c_str, nullptr);
+    glCompileShader(shader);
 
-        ++line_number;
-    }
+    return shader;
+}
+
+// Line numbers in the log refer to source string numbers set by #line, list
+// which file each of them is.
+static void log_shader_error(uint shader, span<const path> files)
+{
+    int length;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    auto log = std::make_unique<char[]>(length);
+    glGetShaderInfoLog(shader, length, nullptr, log.get());
+
+    string legend;
+    for (size_t i = 0; i < files.size(); i++)
+        legend += fmt::format("  {}: {}\n", i, files[i].string());
 
-    return output.str();
+    logger.error("Shader {} compilation failure:\n{}{}",
+                 files.empty() ? "" : files[0].string(), legend, log.get());
 }
 
-uint Shader::compile_shader_stage(string source, path path,
-                                  const string &defines, GLenum stage)
+static void log_program_error(uint program)
 {
-    uint shader = glCreateShader(stage);
+    int length;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    auto log = std::make_unique<char[]>(length);
+    glGetProgramInfoLog(program, length, nullptr, log.get());
+    logger.error("Shader linking failure:\n{}", log.get());
+}
 
-    auto version_start = source.find("#version");
-    auto version_stop = source.find('\n', version_start) + 1;
+static uint64_t fnv1a(uint64_t hash, string_view bytes)
+{
+    for (const char c : bytes)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
 
-    string default_defines = "#define ENGINE_DEFINES\n";
-    default_defines.append(defines);
+    return hash;
+}
 
-    source.insert(version_stop, default_defines);
+// Program binaries are only valid for the driver that produced them.
+static const string &driver_id()
+{
+    static const string id = fmt::format(
+        "{}|{}|{}", reinterpret_cast<const char *>(glGetString(GL_VENDOR)),
+        reinterpret_cast<const char *>(glGetString(GL_RENDERER)),
+        reinterpret_cast<const char *>(glGetString(GL_VERSION)));
 
-    auto processed = process_includes(source, path, 0);
+    return id;
+}
 
-    auto c_str = processed.c_str();
+static bool binary_cache_supported()
+{
+    static const bool supported = []
+    {
+        int format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        return format_count > 0;
+    }();
 
-    glShaderSource(shader, 1, &c_str, nullptr);
-    glCompileShader(shader);
+    return supported;
+}
+
+// Returns an invalid id when the binary is missing or the driver rejects it,
+// e.g., after a driver update that kept the version string.
+static uint load_program_binary(const path &binary_path)
+{
+    ifstream file(binary_path, ios::binary);
+    if (!file)
+        return invalid_shader_id;
+
+    GLenum format;
+    if (!file.read(reinterpret_cast<char *>(&format), sizeof(GLenum)))
+        return invalid_shader_id;
 
-    int is_compiled;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &is_compiled);
-    if (!is_compiled)
+    const vector<char> data{istreambuf_iterator<char>(file),
+                            istreambuf_iterator<char>()};
+
+    uint program = glCreateProgram();
+    glProgramBinary(program, format, data.data(),
+                    static_cast<GLsizei>(data.size()));
+
+    int is_linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+    if (!is_linked)
     {
-        int length;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
-        auto log = std::make_unique<char[]>(length);
-        glGetShaderInfoLog(shader, length, nullptr, log.get());
-        logger.error("Shader {} compilation failure:\n{}", path.string(),
-                     log.get());
+        glDeleteProgram(program);
         return invalid_shader_id;
     }
 
-    return shader;
+    return program;
 }
 
-optional<Shader> Shader::from_paths(const ShaderPaths &p,
-                                    const ShaderDefines &d)
+static void store_program_binary(uint program, const path &binary_path)
 {
-    uint vert = invalid_shader_id, geom = invalid_shader_id,
-         frag = invalid_shader_id;
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length == 0)
+        return;
+
+    GLenum format;
+    vector<char> data(length);
+    glGetProgramBinary(program, length, nullptr, &format, data.data());
+
+    error_code ec;
+    filesystem::create_directories(binary_path.parent_path(), ec);
+
+    ofstream file(binary_path, ios::binary | ios::trunc);
+    file.write(reinterpret_cast<const char *>(&format), sizeof(GLenum));
+    file.write(data.data(), length);
 
-    if (std::filesystem::exists(p.vert))
+    if (!file)
+        logger.warn("Failed writing program binary: {}", binary_path.string());
+}
+
+optional<Shader> Shader::from_sources(const vector<StageSource> &sources)
+{
+    ZoneScoped;
+
+    const bool cache = use_binary_cache && binary_cache_supported();
+    path binary_path;
+
+    if (cache)
     {
-        vert = compile_shader_stage(utils::from_file(p.vert), p.vert, d.vert,
-                                    GL_VERTEX_SHADER);
-        if (vert == invalid_shader_id)
-            return std::nullopt;
+        uint64_t hash = fnv1a(14695981039346656037ull, driver_id());
+        for (const auto &s : sources)
+            hash = fnv1a(fnv1a(hash, to_string(s.desc.stage)),
+                         s.source.source);
+
+        binary_path = shader_cache_path / fmt::format("{:016x}.bin", hash);
+    }
+
+    shared_ptr<Program> program;
+
+    if (uint id = cache ? load_program_binary(binary_path) : invalid_shader_id;
+        id != invalid_shader_id)
+    {
+        program = make_shared<Program>(Program{
+            .id = id,
+            .uniforms = parse_uniforms(id),
+            .resolved = true,
+        });
     }
     else
     {
-        logger.error("Vertex shader not found at path: {}", p.vert.string());
-        return std::nullopt;
+        vector<uint> stages;
+        for (const auto &s : sources)
+            stages.push_back(compile_shader_stage(s));
+
+        program = link(stages);
+        program->binary_path = std::move(binary_path);
     }
 
-    if (!p.geom.empty())
+    for (const auto &s : sources)
     {
-        if (std::filesystem::exists(p.geom))
-        {
-            geom = compile_shader_stage(utils::from_file(p.geom), p.geom,
-                                        d.geom, GL_GEOMETRY_SHADER);
-            if (geom == invalid_shader_id)
-                return std::nullopt;
-        }
-        else
-        {
-            logger.error("Geometry shader not found at path: {}",
-                         p.geom.string());
-            return std::nullopt;
-        }
+        program->descs.push_back(s.desc);
+        program->files.push_back(s.source.files);
     }
 
-    if (!p.frag.empty())
+    programs.push_back(program);
+
+    return Shader{std::move(program)};
+}
+
+optional<Shader> Shader::from_paths(const ShaderPaths &p,
+                                    const ShaderDefines &d)
+{
+    vector<StageSource> sources;
+
+    const auto add_stage = [&](GLenum stage, const path &path,
+                               const string &defines)
     {
-        if (std::filesystem::exists(p.frag))
+        auto source = load_stage({stage, path, defines});
+        if (source)
+            sources.push_back(std::move(*source));
+
+        return source.has_value();
+    };
+
+    if (!add_stage(GL_VERTEX_SHADER, p.vert, d.vert))
+        return std::nullopt;
+
+    if (!p.geom.empty() && !add_stage(GL_GEOMETRY_SHADER, p.geom, d.geom))
+        return std::nullopt;
+
+    if (!p.frag.empty() && !add_stage(GL_FRAGMENT_SHADER, p.frag, d.frag))
+        return std::nullopt;
+
+    return from_sources(sources);
+}
+
+std::optional<Shader> Shader::from_comp_path(const path &path,
+                                             const string &defines)
+{
+    auto source = load_stage({GL_COMPUTE_SHADER, path, defines});
+    if (!source)
+        return std::nullopt;
+
+    return from_sources({std::move(*source)});
+}
+
+Shader::Shader(shared_ptr<Program> program) : program{std::move(program)} {}
+
+Shader::Shader() : program{make_shared<Program>(Program{.resolved = true})} {}
+
+optional<Shader> Shader::from_stages(const std::initializer_list<uint> &stages)
+{
+    return Shader{link(span(stages.begin(), stages.size()))};
+}
+
+shared_ptr<Shader::Program> Shader::link(span<const uint> stages)
+{
+    unsigned int id = glCreateProgram();
+
+    for (const auto &stage : stages)
+        glAttachShader(id, stage);
+
+    glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(id);
+
+    auto program = make_shared<Program>(Program{
+        .id = id,
+        .stages = vector<uint>(stages.begin(), stages.end()),
+    });
+
+    pending.push_back(program);
+
+    return program;
+}
+
+void Shader::resolve(Program &p)
+{
+    if (p.resolved)
+        return;
+
+    ZoneScoped;
+
+    p.resolved = true;
+
+    bool success = true;
+
+    for (size_t i = 0; i < p.stages.size(); i++)
+    {
+        int is_compiled;
+        glGetShaderiv(p.stages[i], GL_COMPILE_STATUS, &is_compiled);
+        if (!is_compiled)
         {
-            frag = compile_shader_stage(utils::from_file(p.frag), p.frag,
-                                        d.frag, GL_FRAGMENT_SHADER);
-            if (frag == invalid_shader_id)
-                return std::nullopt;
+            log_shader_error(p.stages[i], i < p.files.size()
+                                              ? span<const path>(p.files[i])
+                                              : span<const path>{});
+            success = false;
         }
-        else
+    }
+
+    if (success)
+    {
+        int is_linked;
+        glGetProgramiv(p.id, GL_LINK_STATUS, &is_linked);
+        if (!is_linked)
         {
-            logger.error("Fragment shader not found at path: {}",
-                         p.frag.string());
-            return std::nullopt;
+            log_program_error(p.id);
+            success = false;
         }
     }
 
-    if (p.geom.empty() && !p.frag.empty())
-        return Shader::from_stages({vert, frag});
+    for (const auto &stage : p.stages)
+        glDeleteShader(stage);
+
+    p.stages.clear();
 
-    if (!p.geom.empty() && p.frag.empty())
-        return Shader::from_stages({vert, geom});
+    if (!success)
+    {
+        glDeleteProgram(p.id);
+        p.id = invalid_shader_id;
+        return;
+    }
 
-    if (!p.geom.empty() && !p.frag.empty())
-        return Shader::from_stages({vert, geom, frag});
+    p.uniforms = parse_uniforms(p.id);
 
-    return Shader::from_stages({vert});
+    if (!p.binary_path.empty())
+        store_program_binary(p.id, p.binary_path);
 }
 
-std::optional<Shader> Shader::from_comp_path(const path &path,
-                                             const string &defines)
+// Not part of the generated loader, which only covers core 4.6.
+constexpr GLenum completion_status = 0x91B1;
+using MaxShaderCompilerThreadsFn = void (*)(GLuint count);
+
+void Shader::enable_parallel_compile(GLADloadproc load)
 {
-    uint comp;
+    int extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
 
-    if (std::filesystem::exists(path))
+    for (int i = 0; i < extension_count; i++)
     {
-        comp = compile_shader_stage(utils::from_file(path), path, defines,
-                                    GL_COMPUTE_SHADER);
-        if (comp == invalid_shader_id)
-            return std::nullopt;
+        const string_view extension = reinterpret_cast<const char *>(
+            glGetStringi(GL_EXTENSIONS, static_cast<uint>(i)));
+
+        const char *function = nullptr;
+        if (extension == "GL_KHR_parallel_shader_compile")
+            function = "glMaxShaderCompilerThreadsKHR";
+        else if (extension == "GL_ARB_parallel_shader_compile")
+            function = "glMaxShaderCompilerThreadsARB";
+
+        if (function == nullptr)
+            continue;
+
+        const auto max_threads =
+            reinterpret_cast<MaxShaderCompilerThreadsFn>(load(function));
+
+        if (max_threads == nullptr)
+            continue;
+
+        // Let the implementation pick the thread count.
+        max_threads(0xFFFFFFFF);
+        parallel_compile = true;
+
+        return;
     }
-    else
+
+    logger.info("Parallel shader compilation not supported");
+}
+
+bool Shader::pending_ready()
+{
+    if (!parallel_compile)
+        return pending.empty();
+
+    for (const auto &weak : pending)
     {
-        logger.error("Compute shader not found at path: {}", path.string());
-        return std::nullopt;
+        const auto p = weak.lock();
+        if (!p || p->resolved)
+            continue;
+
+        int is_complete;
+        glGetProgramiv(p->id, completion_status, &is_complete);
+        if (!is_complete)
+            return false;
     }
 
-    return Shader::from_stages({comp});
+    return true;
 }
 
-Shader::Shader(uint id, UniformMap uniforms)
-    : id{id}, uniforms{std::move(uniforms)}
+void Shader::resolve_pending()
 {
+    ZoneScoped;
+
+    for (const auto &weak : pending)
+        if (const auto p = weak.lock())
+            resolve(*p);
+
+    pending.clear();
 }
 
-Shader::Shader() : id{invalid_shader_id}, uniforms{UniformMap{}} {}
+bool Shader::rebuild(Program &p)
+{
+    ZoneScoped;
 
-optional<Shader> Shader::from_stages(const std::initializer_list<uint> &stages)
+    resolve(p);
+
+    vector<StageSource> sources;
+
+    for (const auto &desc : p.descs)
+    {
+        auto source = load_stage(desc);
+        if (!source)
+            return false;
+
+        sources.push_back(std::move(*source));
+    }
+
+    const auto fresh_program = from_sources(sources)->program;
+    auto &fresh = *fresh_program;
+    resolve(fresh);
+
+    if (fresh.id == invalid_shader_id)
+        return false;
+
+    if (p.id != invalid_shader_id)
+        glDeleteProgram(p.id);
+
+    p.id = fresh.id;
+    p.uniforms = std::move(fresh.uniforms);
+    p.missing.clear();
+    // Locations may have moved, handles are looked up again when set.
+    p.generation++;
+    p.files = std::move(fresh.files);
+
+    return true;
+}
+
+void Shader::reload(span<const path> changed)
 {
-    unsigned int program = glCreateProgram();
+    ZoneScoped;
 
-    for (const auto &stage : stages)
-        glAttachShader(program, stage);
+    vector<path> normal;
 
-    glLinkProgram(program);
+    for (const auto &file : changed)
+    {
+        preprocessor.invalidate(file);
+        normal.push_back(file.lexically_normal());
+    }
 
-    int is_linked;
-    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
-    if (!is_linked)
+    const auto depends = [&normal](const Program &p)
     {
-        int length;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
-        auto log = std::make_unique<char[]>(length);
-        glGetProgramInfoLog(program, length, nullptr, log.get());
-        logger.error("Shader linking failure:\n{}", log.get());
-        return std::nullopt;
+        for (const auto &stage_files : p.files)
+            for (const auto &file : stage_files)
+                if (ranges::find(normal, file.lexically_normal()) !=
+                    normal.end())
+                    return true;
+
+        return false;
+    };
+
+    // Rebuilding registers new programs, only visit the existing ones.
+    const auto existing = programs;
+
+    for (const auto &weak : existing)
+    {
+        const auto p = weak.lock();
+        if (!p || !depends(*p))
+            continue;
+
+        if (rebuild(*p))
+            logger.info("Reloaded {}", p->descs[0].path.string());
+        else
+            logger.error("Reloading {} failed, keeping previous program",
+                         p->descs[0].path.string());
     }
 
-    auto uniforms = parse_uniforms(program);
+    erase_if(programs, [](const auto &weak) { return weak.expired(); });
+    erase_if(pending, [](const auto &weak) { return weak.expired(); });
+}
 
-    for (const auto &stage : stages)
-        glDeleteShader(stage);
+UniformHandle Shader::uniform(UniformName name) const
+{
+    resolve(*program);
+
+    const auto &uniforms = program->uniforms;
+    const auto it = uniforms.find(name.hash);
+
+    if (it == uniforms.end())
+    {
+        // Uniforms the compiler optimized out are looked up every frame.
+        if (program->missing.insert(name.hash).second)
+            logger.error("Uniform {} not active in program {}", name.name,
+                         program->id);
+
+        // Stays a no-op until a reload makes the uniform active.
+        return UniformHandle{
+            .hash = name.hash,
+            .generation = program->generation,
+        };
+    }
+
+    auto handle = it->second;
+    handle.hash = name.hash;
+    handle.generation = program->generation;
 
-    return std::make_optional<Shader>(Shader{program, uniforms});
+    return handle;
 }
 
-void Shader::set(const std::string &name, const glm::mat4 &value) const
+UniformHandle Shader::current(UniformHandle u) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniformMatrix4fv(id, uniform.location, uniform.count, false,
+    if (u.generation == program->generation || u.hash == 0)
+        return u;
+
+    const auto it = program->uniforms.find(u.hash);
+    if (it == program->uniforms.end())
+        return UniformHandle{};
+
+    return it->second;
+}
+
+void Shader::set(UniformHandle u, const glm::mat4 &value) const
+{
+    u = current(u);
+    glProgramUniformMatrix4fv(program->id, u.location, u.count, false,
                               glm::value_ptr(value));
 }
 
-void Shader::set(const std::string &name,
-                 const std::span<glm::mat4> values) const
+void Shader::set(UniformHandle u, const std::span<glm::mat4> values) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniformMatrix4fv(id, uniform.location, uniform.count, false,
+    u = current(u);
+    glProgramUniformMatrix4fv(program->id, u.location, u.count, false,
                               reinterpret_cast<float *>(values.data()));
 }
 
-void Shader::set(const std::string &name, const glm::mat3 &value) const
+void Shader::set(UniformHandle u, const glm::mat3 &value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniformMatrix3fv(id, uniform.location, uniform.count, false,
+    u = current(u);
+    glProgramUniformMatrix3fv(program->id, u.location, u.count, false,
                               glm::value_ptr(value));
 }
 
-void Shader::set(const std::string &name, const glm::vec2 &value) const
+void Shader::set(UniformHandle u, const glm::vec2 &value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform2fv(id, uniform.location, uniform.count,
+    u = current(u);
+    glProgramUniform2fv(program->id, u.location, u.count,
                         glm::value_ptr(value));
 }
 
-void Shader::set(const std::string &name, const glm::ivec2 &value) const
+void Shader::set(UniformHandle u, const glm::ivec2 &value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform2iv(id, uniform.location, uniform.count,
+    u = current(u);
+    glProgramUniform2iv(program->id, u.location, u.count,
                         glm::value_ptr(value));
 }
 
-void Shader::set(const std::string &name, const glm::vec3 &value) const
+void Shader::set(UniformHandle u, const glm::vec3 &value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform3fv(id, uniform.location, uniform.count,
+    u = current(u);
+    glProgramUniform3fv(program->id, u.location, u.count,
                         glm::value_ptr(value));
 }
 
-void Shader::set(const std::string &name,
-                 const std::span<glm::vec3> values) const
+void Shader::set(UniformHandle u, const std::span<glm::vec3> values) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform3fv(id, uniform.location, uniform.count,
+    u = current(u);
+    glProgramUniform3fv(program->id, u.location, u.count,
                         reinterpret_cast<float *>(values.data()));
 }
 
-void Shader::set(const std::string &name, const glm::ivec3 &value) const
+void Shader::set(UniformHandle u, const glm::ivec3 &value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform3iv(id, uniform.location, uniform.count,
+    u = current(u);
+    glProgramUniform3iv(program->id, u.location, u.count,
                         glm::value_ptr(value));
 }
 
-void Shader::set(const std::string &name, float value) const
+void Shader::set(UniformHandle u, float value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform1f(id, uniform.location, value);
+    u = current(u);
+    glProgramUniform1f(program->id, u.location, value);
 }
 
-void Shader::set(const std::string &name, std::span<float> value) const
+void Shader::set(UniformHandle u, std::span<float> value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform1fv(id, uniform.location, uniform.count, value.data());
+    u = current(u);
+    glProgramUniform1fv(program->id, u.location, u.count, value.data());
 }
 
-void Shader::set(const std::string &name, int value) const
+void Shader::set(UniformHandle u, int value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform1i(id, uniform.location, value);
+    u = current(u);
+    glProgramUniform1i(program->id, u.location, value);
 }
 
-void Shader::set(const std::string &name, uint value) const
+void Shader::set(UniformHandle u, uint value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform1ui(id, uniform.location, value);
+    u = current(u);
+    glProgramUniform1ui(program->id, u.location, value);
 }
 
-void Shader::set(const std::string &name, bool value) const
+void Shader::set(UniformHandle u, bool value) const
 {
-    auto uniform = uniforms.at(name);
-    glProgramUniform1i(id, uniform.location, value);
+    u = current(u);
+    glProgramUniform1i(program->id, u.location, value);
 }
 
-uint Shader::get_id() const { return id; }
+uint Shader::get_id() const
+{
+    resolve(*program);
+    return program->id;
+}
 
 UniformMap Shader::parse_uniforms(uint program)
 {
@@ -352,8 +639,12 @@ UniformMap Shader::parse_uniforms(uint program)
         glGetActiveUniform(program, i, max_length, &length, &size, &type,
                            &name[0]);
 
-        Uniform uniform{glGetUniformLocation(program, name.get()), size};
-        uniforms.emplace(std::make_pair(string(name.get(), length), uniform));
+        const UniformHandle uniform{glGetUniformLocation(program, name.get()),
+                                    size};
+        const string_view view(name.get(), length);
+
+        if (!uniforms.emplace(hash_uniform_name(view), uniform).second)
+            logger.error("Uniform name hash collision: {}", view);
     }
 
     return uniforms;
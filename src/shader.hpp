@@ -5,20 +5,54 @@
 #include <optional>
 #include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include "constants.hpp"
+#include "shader_preprocessor.hpp"
 
 namespace engine
 {
 
-struct Uniform
+// FNV-1a, usable at compile time.
+constexpr uint64_t hash_uniform_name(std::string_view name)
 {
-    int location;
-    int count;
+    uint64_t hash = 14695981039346656037ull;
+
+    for (const char c : name)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+
+    return hash;
+}
+
+// Uniform name hashed at compile time, string literals convert implicitly.
+struct UniformName
+{
+    uint64_t hash;
+    // Only kept for error messages.
+    const char *name;
+
+    consteval UniformName(const char *name)
+        : hash(hash_uniform_name(name)), name(name)
+    {
+    }
+};
+
+// Resolved uniform location, cheap to pass around. Setting an invalid
+// handle is a no-op. Handles resolved before a program was reloaded are
+// looked up again by name when set.
+struct UniformHandle
+{
+    int location = -1;
+    int count = 0;
+    uint64_t hash = 0;
+    // Of the program the location was resolved from.
+    uint32_t generation = 0;
 };
 
 struct ShaderPaths
@@ -35,21 +69,83 @@ struct ShaderDefines
     std::string frag{};
 };
 
-using UniformMap = std::unordered_map<std::string, Uniform>;
+struct IdentityHash
+{
+    size_t operator()(uint64_t hash) const { return hash; }
+};
+
+// Keyed by name hash.
+using UniformMap = std::unordered_map<uint64_t, UniformHandle, IdentityHash>;
 
 class Shader
 {
-    uint id;
+    // Where a stage comes from, kept for reloading.
+    struct StageDesc
+    {
+        GLenum stage;
+        std::filesystem::path path;
+        std::string defines;
+    };
+
+    // Fully preprocessed source of a single stage.
+    struct StageSource
+    {
+        StageDesc desc;
+        PreprocessedSource source;
+    };
+
+    // Shared between copies, compile and link status are only checked once
+    // the program is first used so the driver can build programs
+    // concurrently.
+    struct Program
+    {
+        uint id = invalid_shader_id;
+        UniformMap uniforms{};
+        // Names looked up but not active, reported once per program.
+        std::unordered_set<uint64_t, IdentityHash> missing{};
+        // Bumped by every reload, invalidates the locations of handles.
+        uint32_t generation = 0;
+        bool resolved = false;
+        // Released once resolved.
+        std::vector<uint> stages{};
+        // Empty for programs linked from stages compiled elsewhere, these
+        // can't be reloaded.
+        std::vector<StageDesc> descs{};
+        // Source files of each stage including their includes, for mapping
+        // compile errors and finding programs affected by file changes.
+        std::vector<std::vector<std::filesystem::path>> files{};
+        // Empty when the binary cache is disabled.
+        std::filesystem::path binary_path{};
+    };
+
+    std::shared_ptr<Program> program;
+
+    static inline std::vector<std::weak_ptr<Program>> pending{};
+    // Every program built from files, for reloading.
+    static inline std::vector<std::weak_ptr<Program>> programs{};
+    static inline bool parallel_compile = false;
+    static inline ShaderPreprocessor preprocessor{};
+
+    explicit Shader(std::shared_ptr<Program> program);
+
+    static void resolve(Program &p);
+    static bool rebuild(Program &p);
     static UniformMap parse_uniforms(uint program);
-    static uint compile_shader_stage(std::string source,
-                                     std::filesystem::path path,
-                                     const std::string &defines, GLenum stage);
+    // The handle with its location in the current program.
+    UniformHandle current(UniformHandle u) const;
+    static std::optional<StageSource>
+    load_stage(const StageDesc &desc);
+    static uint compile_shader_stage(const StageSource &s);
+    static std::optional<Shader>
+    from_sources(const std::vector<StageSource> &sources);
+    static std::shared_ptr<Program> link(std::span<const uint> stages);
 
   public:
-    UniformMap uniforms;
+    // Load linked programs from shader_cache_path when the driver and the
+    // preprocessed sources match, and store them after compiling otherwise.
+    static inline bool use_binary_cache = true;
 
     Shader();
-    Shader(uint program, UniformMap uniforms);
     static std::optional<Shader> from_paths(const ShaderPaths &p,
                                             const ShaderDefines &d = {});
     static std::optional<Shader>
@@ -58,21 +154,44 @@ class Shader
     static std::optional<Shader>
     from_stages(const std::initializer_list<uint> &stages);
 
+    // Let the driver compile on its own threads when
+    // GL_KHR_parallel_shader_compile or the ARB variant is available. Call
+    // once after loading GL.
+    static void enable_parallel_compile(GLADloadproc load);
+    // True when every submitted program finished building, never blocks.
+    static bool pending_ready();
+    // Check status and parse uniforms of every submitted program, blocking
+    // until the driver is done with them.
+    static void resolve_pending();
+
+    // Rebuild every program depending on one of the changed files, keeping
+    // the previous program when the new one fails to build. Programs are
+    // updated in place, so all copies of a Shader see the new program.
+    static void reload(std::span<const std::filesystem::path> changed);
+
     uint get_id() const;
 
-    void set(const std::string &name, const glm::mat4 &value) const;
-    void set(const std::string &name, const std::span<glm::mat4> values) const;
-    void set(const std::string &name, const glm::mat3 &value) const;
-    void set(const std::string &name, const glm::vec2 &value) const;
-    void set(const std::string &name, const glm::ivec2 &value) const;
-    void set(const std::string &name, const glm::vec3 &value) const;
-    void set(const std::string &name, const glm::ivec3 &value) const;
-    void set(const std::string &name, const std::span<glm::vec3> values) const;
-    void set(const std::string &name, float value) const;
-    void set(const std::string &name, std::span<float> value) const;
-    void set(const std::string &name, int value) const;
-    void set(const std::string &name, uint value) const;
-    void set(const std::string &name, bool value) const;
+    // Resolve once and keep the handle for uniforms set in loops.
+    UniformHandle uniform(UniformName name) const;
+
+    void set(UniformHandle u, const glm::mat4 &value) const;
+    void set(UniformHandle u, const std::span<glm::mat4> values) const;
+    void set(UniformHandle u, const glm::mat3 &value) const;
+    void set(UniformHandle u, const glm::vec2 &value) const;
+    void set(UniformHandle u, const glm::ivec2 &value) const;
+    void set(UniformHandle u, const glm::vec3 &value) const;
+    void set(UniformHandle u, const glm::ivec3 &value) const;
+    void set(UniformHandle u, const std::span<glm::vec3> values) const;
+    void set(UniformHandle u, float value) const;
+    void set(UniformHandle u, std::span<float> value) const;
+    void set(UniformHandle u, int value) const;
+    void set(UniformHandle u, uint value) const;
+    void set(UniformHandle u, bool value) const;
+
+    template <typename T> void set(UniformName name, const T &value) const
+    {
+        set(uniform(name), value);
+    }
 };
 
 GLuint upload_cube_map(const std::array<std::filesystem::path, 6> &paths);
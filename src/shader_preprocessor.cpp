@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <iterator>
+
+#include <Tracy.hpp>
+#include <fmt/format.h>
+
+#include "constants.hpp"
+#include "logger.hpp"
+#include "shader_preprocessor.hpp"
+#include "utils.hpp"
+
+using namespace engine;
+using namespace std;
+
+using std::filesystem::path;
+
+static string_view trim(string_view s)
+{
+    const auto first = s.find_first_not_of(" \t\r");
+    if (first == string_view::npos)
+        return {};
+
+    const auto last = s.find_last_not_of(" \t\r");
+    return s.substr(first, last - first + 1);
+}
+
+// Splits "#  name args" into its name and arguments, returns false when the
+// line is not a directive.
+static bool parse_directive(string_view line, string_view &name,
+                            string_view &args)
+{
+    line = trim(line);
+    if (line.empty() || line.front() != '#')
+        return false;
+
+    line = trim(line.substr(1));
+
+    const auto name_end = line.find_first_of(" \t");
+    name = line.substr(0, name_end);
+    args = name_end == string_view::npos ? string_view{}
+                                         : trim(line.substr(name_end));
+
+    return true;
+}
+
+// Lines inserted for the defines, the #line directive resumes the stage at
+// line. Callers pass defines with or without a trailing newline, without one
+// the last define would run into the #line directive.
+static string defines_block(string_view defines, uint32_t line)
+{
+    string block = "#define ENGINE_DEFINES\n";
+    block.append(defines);
+    if (!defines.empty() && defines.back() != '\n')
+        block.push_back('\n');
+    fmt::format_to(back_inserter(block), "#line {} 0\n", line);
+
+    return block;
+}
+
+// Name between quotes or angle brackets, empty when malformed.
+static string_view include_name(string_view args)
+{
+    if (args.size() < 2)
+        return {};
+
+    const char close = args.front() == '"'   ? '"'
+                       : args.front() == '<' ? '>'
+                                             : '\0';
+    if (close == '\0')
+        return {};
+
+    const auto end = args.find(close, 1);
+    if (end == string_view::npos)
+        return {};
+
+    return args.substr(1, end - 1);
+}
+
+static bool has_pragma_once(string_view source)
+{
+    size_t start = 0;
+    while (start < source.size())
+    {
+        auto end = source.find('\n', start);
+        if (end == string_view::npos)
+            end = source.size();
+
+        string_view name, args;
+        if (parse_directive(source.substr(start, end - start), name, args) &&
+            name == "pragma" && args == "once")
+            return true;
+
+        start = end + 1;
+    }
+
+    return false;
+}
+
+const ShaderPreprocessor::CachedFile *ShaderPreprocessor::load(const path &path)
+{
+    const auto key = path.lexically_normal().string();
+
+    if (const auto it = cache.find(key); it != cache.end())
+        return &it->second;
+
+    if (!filesystem::exists(path))
+        return nullptr;
+
+    CachedFile file{utils::from_file(path)};
+    file.once = has_pragma_once(file.source);
+
+    // Node based, so references stay valid while expanding nested includes.
+    return &cache.emplace(key, std::move(file)).first->second;
+}
+
+void ShaderPreprocessor::expand(State &state, string_view source,
+                                uint32_t file_idx, int depth)
+{
+    if (depth > max_include_depth)
+    {
+        logger.error("Include depth exceeds {} in {}, cyclic includes?",
+                     max_include_depth, state.files[file_idx].string());
+        return;
+    }
+
+    auto &out = state.output;
+
+    // Number of the line following the current one, as #line expects.
+    uint32_t next_line = 1;
+    size_t start = 0;
+
+    while (start < source.size())
+    {
+        auto end = source.find('\n', start);
+        if (end == string_view::npos)
+            end = source.size();
+
+        const string_view line = source.substr(start, end - start);
+        start = end + 1;
+        next_line++;
+
+        string_view name, args;
+        if (!parse_directive(line, name, args))
+        {
+            out.append(line);
+            out.push_back('\n');
+        }
+        else if (name == "include")
+        {
+            include(state, args, file_idx, next_line, depth);
+        }
+        else if (name == "pragma" && args == "once")
+        {
+            // Keep line numbers intact.
+            out.push_back('\n');
+        }
+        else if (name == "version" && file_idx == 0 && !state.version_seen)
+        {
+            state.version_seen = true;
+
+            out.append(line);
+            out.push_back('\n');
+            out.append(defines_block(state.defines, next_line));
+        }
+        else
+        {
+            out.append(line);
+            out.push_back('\n');
+        }
+    }
+}
+
+void ShaderPreprocessor::include(State &state, string_view args,
+                                 uint32_t file_idx, uint32_t next_line,
+                                 int depth)
+{
+    auto &out = state.output;
+
+    const auto name = include_name(args);
+    if (name.empty())
+    {
+        logger.error("Malformed include in {}: {}",
+                     state.files[file_idx].string(), args);
+        out.push_back('\n');
+        return;
+    }
+
+    auto include_path = shaders_path;
+    include_path.concat(name.begin(), name.end());
+
+    const auto *file = load(include_path);
+    if (file == nullptr)
+    {
+        logger.error("Cannot open include file: {}", name);
+        out.push_back('\n');
+        return;
+    }
+
+    // Files keep the same source string number when included again.
+    const auto it = ranges::find(state.files, include_path);
+    const auto include_idx = static_cast<uint32_t>(it - state.files.begin());
+
+    if (it != state.files.end() && file->once)
+    {
+        out.push_back('\n');
+        return;
+    }
+
+    if (it == state.files.end())
+        state.files.push_back(include_path);
+
+    fmt::format_to(back_inserter(out), "#line 1 {}\n", include_idx);
+    expand(state, file->source, include_idx, depth + 1);
+    fmt::format_to(back_inserter(out), "#line {} {}\n", next_line, file_idx);
+}
+
+PreprocessedSource ShaderPreprocessor::process(string_view source,
+                                               const path &path,
+                                               string_view defines)
+{
+    ZoneScoped;
+
+    State state{.files = {path}, .defines = defines};
+    state.output.reserve(source.size() * 2);
+
+    expand(state, source, 0, 0);
+
+    if (!state.version_seen)
+    {
+        logger.warn("Shader {} has no #version directive", path.string());
+        state.output.insert(0, defines_block(defines, 1));
+    }
+
+    return PreprocessedSource{std::move(state.output), std::move(state.files)};
+}
+
+void ShaderPreprocessor::invalidate(const path &path)
+{
+    cache.erase(path.lexically_normal().string());
+}
+
+void ShaderPreprocessor::clear() { cache.clear(); }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace engine
+{
+
+struct PreprocessedSource
+{
+    std::string source;
+    // Indexed by the source string number of #line directives, the first
+    // entry is the stage itself.
+    std::vector<std::filesystem::path> files;
+};
+
+// Expands #include directives relative to shaders_path in a single pass over
+// each file. Includes are read from disk once and kept in memory, files
+// containing #pragma once are only expanded once per stage.
+class ShaderPreprocessor
+{
+    struct CachedFile
+    {
+        std::string source;
+        bool once = false;
+    };
+
+    struct State
+    {
+        std::string output;
+        std::vector<std::filesystem::path> files;
+        std::string_view defines;
+        bool version_seen = false;
+    };
+
+    static constexpr int max_include_depth = 16;
+
+    // Keyed by resolved path.
+    std::unordered_map<std::string, CachedFile> cache;
+
+    const CachedFile *load(const std::filesystem::path &path);
+    void expand(State &state, std::string_view source, uint32_t file_idx,
+                int depth);
+    void include(State &state, std::string_view args, uint32_t file_idx,
+                 uint32_t next_line, int depth);
+
+  public:
+    // Defines are inserted after the #version directive.
+    PreprocessedSource process(std::string_view source,
+                               const std::filesystem::path &path,
+                               std::string_view defines);
+
+    // Drop a cached include, e.g., after it changed on disk.
+    void invalidate(const std::filesystem::path &path);
+    void clear();
+};
+
+} // namespace engine
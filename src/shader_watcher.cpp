@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <Tracy.hpp>
+
+#include "logger.hpp"
+#include "shader.hpp"
+#include "shader_watcher.hpp"
+
+using namespace engine;
+using namespace std;
+
+using std::filesystem::path;
+
+#ifdef __linux__
+
+ShaderWatcher::ShaderWatcher(const path &root)
+{
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        logger.error("Failed initializing inotify, shader reloading disabled");
+        return;
+    }
+
+    // Editors either write in place or rename a temporary file over the
+    // original.
+    const auto add = [this](const path &dir)
+    {
+        const int wd = inotify_add_watch(fd, dir.c_str(),
+                                         IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0)
+            logger.warn("Failed watching {}", dir.string());
+        else
+            directories.emplace(wd, dir);
+    };
+
+    add(root);
+
+    error_code ec;
+    for (const auto &entry : filesystem::recursive_directory_iterator(root, ec))
+        if (entry.is_directory())
+            add(entry.path());
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+void ShaderWatcher::poll()
+{
+    if (fd < 0)
+        return;
+
+    ZoneScoped;
+
+    vector<path> changed;
+
+    alignas(inotify_event) char buffer[4096];
+
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const auto *event =
+                reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            const auto dir = directories.find(event->wd);
+            if (event->len == 0 || dir == directories.end())
+                continue;
+
+            auto file = dir->second / event->name;
+            if (ranges::find(changed, file) == changed.end())
+                changed.push_back(std::move(file));
+        }
+    }
+
+    if (!changed.empty())
+        Shader::reload(changed);
+}
+
+#else
+
+ShaderWatcher::ShaderWatcher(const path &)
+{
+    logger.warn("Shader reloading is only supported on Linux");
+}
+
+ShaderWatcher::~ShaderWatcher() = default;
+
+void ShaderWatcher::poll() {}
+
+#endif
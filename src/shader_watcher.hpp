@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+#include <unordered_map>
+
+namespace engine
+{
+
+// Watches a shader directory and its subdirectories with inotify and reloads
+// the programs affected by saved files. Only supported on Linux, elsewhere
+// polling does nothing.
+class ShaderWatcher
+{
+    int fd = -1;
+    // Directory of each watch descriptor.
+    std::unordered_map<int, std::filesystem::path> directories;
+
+  public:
+    explicit ShaderWatcher(const std::filesystem::path &root);
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+    // Never blocks, call on the GL thread.
+    void poll();
+};
+
+} // namespace engine
@@ -0,0 +1,163 @@
+#include <string>
+
+#include <fmt/format.h>
+#include <glad/glad.h>
+
+#include "logger.hpp"
+#include "telemetry.hpp"
+
+using namespace engine;
+using namespace std;
+
+using std::filesystem::path;
+
+using Clock = chrono::steady_clock;
+
+// Track ids of the Chrome trace.
+constexpr int cpu_track = 0;
+constexpr int gpu_track = 1;
+
+// Zone names are identifiers chosen in code, only quotes and backslashes
+// need escaping.
+static string escape(const string &s)
+{
+    string result;
+    result.reserve(s.size());
+
+    for (const char c : s)
+    {
+        if (c == '"' || c == '\\')
+            result.push_back('\\');
+        result.push_back(c);
+    }
+
+    return result;
+}
+
+TelemetryRecorder::TelemetryRecorder(const path &path)
+{
+    if (path.extension() == ".json")
+        format = Format::chrome_trace;
+    else if (path.extension() == ".csv")
+        format = Format::csv;
+    else
+    {
+        logger.error("Unknown telemetry format {}, expected .json or .csv",
+                     path.string());
+        return;
+    }
+
+    file.open(path, ios::trunc);
+    if (!file)
+    {
+        logger.error("Failed opening telemetry file {}", path.string());
+        return;
+    }
+
+    cpu_epoch = Clock::now();
+    glGetInteger64v(GL_TIMESTAMP, &gpu_epoch_ns);
+
+    if (format == Format::csv)
+    {
+        file << "frame,zone,cpu_ms,gpu_ms,draw_calls,triangles\n";
+        return;
+    }
+
+    file << "{\"traceEvents\":[";
+
+    for (const auto &[track, name] : {pair{cpu_track, "CPU"},
+                                      pair{gpu_track, "GPU"}})
+        write_event(fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\","
+                                "\"pid\":0,\"tid\":{},"
+                                "\"args\":{{\"name\":\"{}\"}}}}",
+                                track, name));
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+    if (file.is_open() && format == Format::chrome_trace)
+        file << "]}\n";
+}
+
+double TelemetryRecorder::cpu_us(Clock::time_point t) const
+{
+    return chrono::duration<double, micro>(t - cpu_epoch).count();
+}
+
+double TelemetryRecorder::gpu_us(uint64_t t) const
+{
+    return static_cast<double>(static_cast<int64_t>(t) - gpu_epoch_ns) / 1e3;
+}
+
+void TelemetryRecorder::write_event(const string &event)
+{
+    if (!first_event)
+        file << ',';
+
+    file << '\n' << event;
+    first_event = false;
+}
+
+void TelemetryRecorder::record(const ProfiledFrame &frame)
+{
+    if (!file.is_open())
+        return;
+
+    if (format == Format::csv)
+    {
+        for (const auto &z : frame.zones)
+        {
+            const double cpu_ms =
+                chrono::duration<double, milli>(z.cpu_end - z.cpu_begin)
+                    .count();
+            const double gpu_ms =
+                static_cast<double>(z.gpu_end_ns - z.gpu_begin_ns) / 1e6;
+
+            file << fmt::format("{},\"{}\",{:.4f},{:.4f},{},{}\n", frame.index,
+                                profiler_zone_path(z.zone), cpu_ms, gpu_ms,
+                                z.draw_calls, z.triangles);
+        }
+
+        return;
+    }
+
+    uint32_t draw_calls = 0;
+    uint64_t triangles = 0;
+
+    for (const auto &z : frame.zones)
+    {
+        // The path's last component, the trace nests zones by time.
+        const string zone_path = profiler_zone_path(z.zone);
+        const string name = escape(zone_path.substr(zone_path.rfind('/') + 1));
+
+        write_event(fmt::format(
+            "{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},"
+            "\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"frame\":{}}}}}",
+            name, cpu_track, cpu_us(z.cpu_begin),
+            chrono::duration<double, micro>(z.cpu_end - z.cpu_begin).count(),
+            frame.index));
+
+        write_event(fmt::format(
+            "{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},"
+            "\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"frame\":{},"
+            "\"draw_calls\":{},\"triangles\":{}}}}}",
+            name, gpu_track, gpu_us(z.gpu_begin_ns),
+            static_cast<double>(z.gpu_end_ns - z.gpu_begin_ns) / 1e3,
+            frame.index, z.draw_calls, z.triangles));
+
+        // Counts are inclusive, the root zones hold the frame's totals.
+        if (zone_path.find('/') == string::npos)
+        {
+            draw_calls += z.draw_calls;
+            triangles += z.triangles;
+        }
+    }
+
+    if (frame.zones.empty())
+        return;
+
+    write_event(fmt::format(
+        "{{\"name\":\"Draws\",\"ph\":\"C\",\"pid\":0,\"ts\":{:.3f},"
+        "\"args\":{{\"draw_calls\":{},\"triangles\":{}}}}}",
+        cpu_us(frame.zones.front().cpu_begin), draw_calls, triangles));
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+#include "profiler.hpp"
+
+namespace engine
+{
+
+// Writes the zone timings and draw counts of every profiled frame to a file,
+// for comparing builds offline. The format follows the extension: ".json"
+// writes a Chrome trace for about:tracing or Perfetto with CPU and GPU zones
+// on separate tracks, ".csv" writes one row per zone instance.
+class TelemetryRecorder
+{
+    enum class Format
+    {
+        chrome_trace,
+        csv,
+    };
+
+    Format format = Format::csv;
+    std::ofstream file;
+    bool first_event = true;
+
+    // GPU timestamps are mapped onto the CPU clock with a pair of readings
+    // taken at construction.
+    std::chrono::steady_clock::time_point cpu_epoch;
+    int64_t gpu_epoch_ns = 0;
+
+    double cpu_us(std::chrono::steady_clock::time_point t) const;
+    double gpu_us(uint64_t t) const;
+
+    void write_event(const std::string &event);
+
+  public:
+    // Needs a current GL context.
+    explicit TelemetryRecorder(const std::filesystem::path &path);
+    ~TelemetryRecorder();
+
+    TelemetryRecorder(const TelemetryRecorder &) = delete;
+    TelemetryRecorder &operator=(const TelemetryRecorder &) = delete;
+
+    void record(const ProfiledFrame &frame);
+};
+
+} // namespace engine
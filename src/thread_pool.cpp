@@ -0,0 +1,49 @@
+#include "thread_pool.hpp"
+
+using namespace engine;
+using namespace std;
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    workers.reserve(thread_count);
+
+    for (size_t i = 0; i < thread_count; i++)
+        workers.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard lock(mutex);
+        stopping = true;
+    }
+
+    cv.notify_all();
+
+    // Remaining jobs are drained before the workers exit.
+    for (auto &worker : workers)
+        worker.join();
+}
+
+size_t ThreadPool::size() const { return workers.size(); }
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        function<void()> job;
+
+        {
+            unique_lock lock(mutex);
+            cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+
+        job();
+    }
+}
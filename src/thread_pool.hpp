@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace engine
+{
+
+// Fixed-size pool of worker threads for CPU-bound jobs that don't touch the
+// GL context, e.g., image decoding.
+class ThreadPool
+{
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    void work();
+
+  public:
+    explicit ThreadPool(
+        size_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    size_t size() const;
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F &&job);
+};
+
+template <typename F>
+std::future<std::invoke_result_t<F>> ThreadPool::submit(F &&job)
+{
+    using Result = std::invoke_result_t<F>;
+
+    // std::function requires copyable targets, packaged_task is move-only.
+    auto task =
+        std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+    auto future = task->get_future();
+
+    {
+        std::lock_guard lock(mutex);
+        jobs.emplace([task] { (*task)(); });
+    }
+
+    cv.notify_one();
+
+    return future;
+}
+
+} // namespace engine